@@ -0,0 +1,139 @@
+/*
+ * Combos: several keys pressed together send one keymap entry.
+ *
+ * Presses of keys that are part of a combo are kept back until the
+ * kept keys match a combo nothing longer starts with, the combo term
+ * is over or any other event comes in. Then the combo is sent, or the
+ * kept presses go on unchanged and in order. Every key costs one walk
+ * of the trie from keymap.c, at most SEQUENCE_KEYS levels deep.
+ * The combo is released with the first of its keys.
+ */
+#include "keymap.h"
+#include "events.h"
+#include "combo.h"
+
+// presses kept back, in the order they came
+static uint8_t keys[SEQUENCE_KEYS];
+static uint8_t count = 0;
+static uint16_t since;
+
+// keys of the combo sent last, their releases are swallowed
+static uint8_t comboDown[SEQUENCE_KEYS];
+static uint8_t comboCount = 0;
+static uint16_t comboEntry = 0;
+
+static uint16_t lookup(uint8_t n, uint8_t *more)
+{
+  uint8_t sorted[SEQUENCE_KEYS];
+  uint8_t i, j, sc;
+
+  for (i = 0; i < n; i++)
+    {
+      sc = keys[i];
+      for (j = i; j > 0 && sorted[j - 1] > sc; j--)
+        sorted[j] = sorted[j - 1];
+      sorted[j] = sc;
+    }
+
+  return keymapCombo(sorted, n, more);
+}
+
+// send the combo of the kept keys or the keys themselves
+static void decide()
+{
+  uint8_t more, i;
+  uint16_t entry = lookup(count, &more);
+
+  if (entry)
+    {
+      for (i = 0; i < count; i++)
+        comboDown[i] = keys[i];
+      comboCount = count;
+      comboEntry = entry;
+      eventPut(EVENT_KEY(entry, 0));
+    }
+  else
+    {
+      for (i = 0; i < count; i++)
+        eventPut(keys[i]);
+    }
+
+  count = 0;
+}
+
+// release of a key of the sent combo?
+static uint8_t comboRelease(uint8_t sc)
+{
+  uint8_t i;
+
+  for (i = 0; i < comboCount; i++)
+    {
+      if (comboDown[i] == sc)
+        {
+          comboDown[i] = comboDown[--comboCount];
+          if (comboEntry)
+            eventPut(EVENT_KEY(comboEntry, 1));
+          comboEntry = 0;
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+void comboFeed(uint16_t ev, uint16_t now)
+{
+  uint8_t rb = ev & 0xff;
+  uint8_t more, i;
+
+  if (!(ev & EVENT_ENTRY))
+    {
+      if ((rb & 0x80) && comboRelease(rb & 0x7f))
+        return;
+
+      if (!(rb & 0x80) && keymapComboKey(rb))
+        {
+          for (i = 0; i < count; i++)
+            if (keys[i] == rb)
+              break;
+
+          if (i == count && count < SEQUENCE_KEYS)
+            {
+              if (count == 0)
+                since = now;
+              keys[count++] = rb;
+
+              if (lookup(count, &more) == 0 && !more)
+                {
+                  // no combo with this key: the ones before go on
+                  // alone, this one may start the next combo
+                  count--;
+                  if (count)
+                    {
+                      decide();
+                      comboFeed(ev, now);
+                    }
+                  else
+                    eventPut(ev);
+                  return;
+                }
+
+              // nothing longer to wait for
+              if (!more)
+                decide();
+              return;
+            }
+        }
+    }
+
+  if (count)
+    decide();
+
+  eventPut(ev);
+}
+
+void comboPoll(uint16_t now)
+{
+  if (count && (uint16_t)(now - since) >= COMBO_TERM)
+    decide();
+}
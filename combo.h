@@ -0,0 +1,22 @@
+#ifndef COMBO_HEADER_H
+# define COMBO_HEADER_H
+
+#include <stdint.h>
+
+// keys of a combo pressed within this many ms of the first one.
+// at 1200 baud the keyboard needs 8 ms per key.
+#ifndef COMBO_TERM
+# define COMBO_TERM  50
+#endif
+
+#ifdef WITH_COMBO
+void comboFeed(uint16_t ev, uint16_t now);
+void comboPoll(uint16_t now);
+#else
+// events go straight to the queue
+# include "events.h"
+# define comboFeed(ev, now)  eventPut(ev)
+# define comboPoll(now)
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Consumer control keys (volume, mute) and their repeat.
+ *
+ * The adapter repeats a held volume key itself: every repeat is a
+ * report with no usage followed by one with the usage again. Other
+ * usages like Mute are toggles and go out once. The
+ * repeat rate follows a curve, slow at first and faster the longer the
+ * key is held. The reports have their own ID and are only sent when no
+ * keyboard report is waiting, a held volume key never takes the place
+ * of a key.
+ */
+#include <avr/pgmspace.h>
+
+#include "sun_defs.h"
+#include "timer.h"
+#include "consumer.h"
+
+// repeats per ms in 0.16 fixed point (Hz * 65.536), by the time
+// the key is held in 256 ms steps. the host polls every 10 ms, 100
+// reports per second, and a repeat takes two: 50 Hz is as fast as it
+// gets.
+static const uint16_t consumerCurve[] PROGMEM = {
+  0,        // 0 - 0.5 s: no repeat yet
+  0,
+  262,      // 4 Hz
+  393,      // 6 Hz
+  524,      // 8 Hz
+  786,      // 12 Hz
+  1049,     // 16 Hz
+  1311,     // 20 Hz from 1.8 s on
+};
+
+#define CURVE_STEPS  (sizeof consumerCurve / sizeof *consumerCurve)
+
+// usage held and usage in the last report sent
+static uint16_t held = 0;
+static uint16_t sent = 0;
+static uint8_t repeats = 0;
+
+// a repeat is due: next report releases, the one after presses again
+static uint8_t repeat = 0;
+
+static uint16_t since;
+static uint16_t phase;
+static uint16_t last;
+
+void consumerPress(uint16_t usage)
+{
+  held = usage;
+  repeats = usage == CKEY_VolumeUp || usage == CKEY_VolumeDown;
+  since = timerNow();
+  phase = 0;
+  repeat = 0;
+}
+
+void consumerRelease(uint16_t usage)
+{
+  if (held == usage)
+    held = 0;
+}
+
+void consumerPoll(uint16_t now)
+{
+  uint16_t ms = now - last;
+  uint16_t step;
+  uint32_t acc;
+
+  last = now;
+
+  if (held == 0 || !repeats)
+    return;
+
+  // the tick wraps after 65 s, stay at the top rate from there
+  step = (uint16_t)(now - since) >> 8;
+  if (step >= CURVE_STEPS - 1)
+    {
+      step = CURVE_STEPS - 1;
+      since = now - ((CURVE_STEPS - 1) << 8);
+    }
+
+  // carry out of the 16 bit phase is a repeat, late ones are merged
+  acc = phase + (uint32_t)ms * pgm_read_word(&consumerCurve[step]);
+  if (acc > 0xffff)
+    repeat = 1;
+  phase = acc;
+}
+
+// fill the consumer report if it has to be sent, returns 0 if not
+uint8_t consumerReport(uint8_t *report)
+{
+  uint16_t usage = held;
+
+  if (repeat && held && sent == held)
+    {
+      usage = 0;
+      repeat = 0;
+    }
+
+  if (usage == sent)
+    return 0;
+
+  sent = usage;
+  report[0] = REPORT_ID_CONSUMER;
+  report[1] = usage & 0xff;
+  report[2] = usage >> 8;
+  return 1;
+}
@@ -0,0 +1,19 @@
+#ifndef CONSUMER_HEADER_H
+# define CONSUMER_HEADER_H
+
+#include <stdint.h>
+
+#ifdef WITH_CONSUMER
+void consumerPress(uint16_t usage);
+void consumerRelease(uint16_t usage);
+void consumerPoll(uint16_t now);
+uint8_t consumerReport(uint8_t *report);
+#else
+// the report descriptor keeps the consumer collection, it is
+// never sent
+# define consumerPress(usage)
+# define consumerRelease(usage)
+# define consumerReport(report)  0
+#endif
+
+#endif
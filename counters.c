@@ -0,0 +1,27 @@
+/*
+ * Runtime counters.
+ *
+ * Every counter is only changed from one place, the interrupt or the
+ * main loop, and stops at its maximum. The watchdog resets are kept
+ * in RAM the start up code doesn't clear, a power on or brown out
+ * starts them over.
+ */
+#include "sun_defs.h"
+#include "trace.h"
+#include "counters.h"
+
+Counters counters;
+
+static uint16_t watchdogResets __attribute__((section(".noinit")));
+
+void countersInit()
+{
+  if (MCUCSR & ((1 << PORF) | (1 << BORF)))
+    watchdogResets = 0;
+  else if (MCUCSR & (1 << WDRF))
+    COUNT(watchdogResets);
+
+  counters.watchdogResets = watchdogResets;
+  traceAdd(TRACE_BOOT, MCUCSR, 0);
+  MCUCSR = 0;
+}
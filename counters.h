@@ -0,0 +1,29 @@
+#ifndef COUNTERS_HEADER_H
+# define COUNTERS_HEADER_H
+
+#include <stdint.h>
+
+// saturating increment, an inc and a test for the interrupts too
+#define COUNT(c)  do { if (++(c) == 0) (c)--; } while (0)
+
+// read by VREQ_COUNTERS_GET while they keep counting: a 32 bit
+// counter may be caught in the middle of a carry, read it twice.
+typedef struct
+{
+  uint32_t rxBytes;          // bytes from the keyboard
+  uint32_t reports;          // interrupt reports handed to the driver
+  uint16_t frameErrors;      // bytes without a stop bit, dropped
+  uint16_t overruns;         // bytes lost in the USART before the interrupt
+  uint16_t rxDropped;        // bytes lost to a full receive buffer
+  uint16_t unknownKeys;      // presses without a keymap entry
+  uint16_t eventOverflows;   // events lost to a full event queue
+  uint16_t heldBack;         // reports due while the host hadn't taken the last one
+  uint16_t ledCommands;      // LED commands sent to the keyboard
+  uint16_t watchdogResets;   // since power on
+} Counters;
+
+extern Counters counters;
+
+void countersInit(void);
+
+#endif
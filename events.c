@@ -0,0 +1,65 @@
+/*
+ * Queue between the key event stages and the report builder.
+ *
+ * Only the main loop uses it. The report builder takes one event
+ * per report, so a press and release queued together still reach
+ * the host as two reports, in the order they were put.
+ */
+#include "led.h"
+#include "counters.h"
+#include "trace.h"
+#include "events.h"
+
+static uint16_t queue[EVENT_QUEUE];
+static uint8_t head = 0;
+static uint8_t tail = 0;
+
+// returns 0 if the queue is full and the event was dropped
+uint8_t eventPut(uint16_t ev)
+{
+  uint8_t next = (head + 1) & (EVENT_QUEUE - 1);
+
+  if (next == tail)
+    {
+      ledStart(LED_ERROR, ledOverflow);
+      COUNT(counters.eventOverflows);
+      traceAdd(TRACE_DROP, ev, ev >> 8);
+      return 0;
+    }
+
+  queue[head] = ev;
+  head = next;
+  return 1;
+}
+
+#ifdef WITH_LEADER
+// ahead of everything queued, for events that were taken out
+// already and have to go before the ones behind them
+uint8_t eventPutFirst(uint16_t ev)
+{
+  uint8_t prev = (tail - 1) & (EVENT_QUEUE - 1);
+
+  if (prev == head)
+    {
+      ledStart(LED_ERROR, ledOverflow);
+      COUNT(counters.eventOverflows);
+      traceAdd(TRACE_DROP, ev, ev >> 8);
+      return 0;
+    }
+
+  tail = prev;
+  queue[tail] = ev;
+  return 1;
+}
+#endif
+
+// returns 0 if there's nothing queued
+uint8_t eventGet(uint16_t *ev)
+{
+  if (tail == head)
+    return 0;
+
+  *ev = queue[tail];
+  tail = (tail + 1) & (EVENT_QUEUE - 1);
+  return 1;
+}
@@ -0,0 +1,23 @@
+#ifndef EVENTS_HEADER_H
+# define EVENTS_HEADER_H
+
+#include <stdint.h>
+
+#define EVENT_QUEUE  16
+
+// a queued key event is either a Sun scancode byte (release in bit 7),
+// resolved against the keymap when it is taken out, or a keymap entry
+// the event stages decided on themselves.
+#define EVENT_ENTRY  0x8000
+#define EVENT_UP     0x4000
+#define EVENT_TURBO  0x2000   // edge made by turbo.c
+
+#define EVENT_KEY(entry, keyUp)  (EVENT_ENTRY | ((keyUp) ? EVENT_UP : 0) | (entry))
+
+uint8_t eventPut(uint16_t ev);
+#ifdef WITH_LEADER
+uint8_t eventPutFirst(uint16_t ev);   // only the leader replays keys
+#endif
+uint8_t eventGet(uint16_t *ev);
+
+#endif
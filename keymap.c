@@ -0,0 +1,336 @@
+/*
+ * Layered scancode -> keymap entry lookup.
+ *
+ * Profile 0 is a set of layer tables, the profiles above it are
+ * deltas against it, marked in a bitmap like the layout deltas: a
+ * complete profile is another 1 KB of flash, the PC profile's delta
+ * is 24 bytes. Switching clears the 16 byte bitmap and marks the
+ * delta's keys in it. The active profile is kept in EEPROM.
+ * Layer 0 is the plain Sun table, the layers above it only list
+ * the keys they change. Every lookup costs one bit test and one
+ * pgm_read_word per active layer, the highest active layer with an
+ * entry wins. Only keys the profile changes scan its delta, a few
+ * entries, instead of the table read.
+ * Layer 0 is adjusted by the delta of the keyboard's layout, runtime
+ * overrides from remap.c go on top of that.
+ * Combos and leader sequences are looked up in tries generated along
+ * with the tables.
+ */
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+
+#include "sun_defs.h"
+#include "keymap.h"
+#include "remap.h"
+#include "keycodes.h"
+
+#ifdef WITH_PROFILES
+static uint8_t eeProfile EEMEM;
+
+// delta of the active profile, its keys are marked in profileBits
+static const KeymapDelta *profileDelta = 0;
+static uint8_t profileBits[128 / 8];
+static uint8_t profile = 0;
+static uint8_t profileSaved = 0;
+#endif
+
+static uint8_t layerToggle = 0;
+static uint8_t layerMomentary = 0;
+static uint8_t layerOneShot = 0;
+
+// delta of the detected layout, 0 for US type 5.
+// keys in the delta are marked in layoutBits.
+static const uint8_t *layoutDelta = 0;
+static uint8_t layoutBits[128 / 8];
+
+// layer each key was pressed on, 2 bits per scancode.
+// the release looks up the same layer, so it always releases
+// the usage that was pressed, whatever is active by then.
+static uint8_t keyLayer[128 / 4];
+
+static uint8_t activeLayers()
+{
+  return 1 | layerToggle | layerMomentary | layerOneShot;
+}
+
+// entry for a plain usage, as used by the deltas and overrides
+uint16_t keymapUsage(uint8_t usage)
+{
+  if (usage >= 0xE0 && usage <= 0xE7)
+    return KEYMAP_ENTRY(KC_MODIFIER, 1 << (usage - 0xE0));
+
+  return usage;
+}
+
+// table entry of the active profile
+static uint16_t tableEntry(uint8_t layer, uint8_t sc)
+{
+#ifdef WITH_PROFILES
+  const KeymapDelta *d;
+
+  if (profileBits[sc >> 3] & (1 << (sc & 7)))
+    {
+      for (d = profileDelta; pgm_read_byte(&(d -> sc)) != 0xff; d++)
+        {
+          if (pgm_read_byte(&(d -> sc)) == sc && pgm_read_byte(&(d -> layer)) == layer)
+            return pgm_read_word(&(d -> entry));
+        }
+    }
+#endif
+
+  return pgm_read_word(&(sunkeycodes[layer][sc]));
+}
+
+// layer 0 entry with the layout delta and the remap overrides
+static uint16_t baseKey(uint8_t sc)
+{
+  const uint8_t *d;
+  uint8_t usage = remapLookup(sc);
+
+  if (usage)
+    return keymapUsage(usage);
+
+  if (layoutBits[sc >> 3] & (1 << (sc & 7)))
+    {
+      for (d = layoutDelta; pgm_read_byte(d) != sc; d += 2)
+        ;
+      return keymapUsage(pgm_read_byte(d + 1));
+    }
+
+  return tableEntry(0, sc);
+}
+
+// highest active layer
+uint8_t keymapLayer()
+{
+  uint8_t active = activeLayers();
+  uint8_t layer = KEYMAP_LAYERS - 1;
+
+  while (!(active & (1 << layer)))
+    layer--;
+
+  return layer;
+}
+
+// entry of a key on the active layers, and the layer it is on
+static uint16_t lookup(uint8_t sc, uint8_t *found)
+{
+  uint8_t active = activeLayers();
+  uint8_t layer;
+  uint16_t entry;
+
+  for (layer = KEYMAP_LAYERS - 1; layer > 0; layer--)
+    {
+      if (active & (1 << layer))
+        {
+          entry = tableEntry(layer, sc);
+          if (entry)
+            {
+              *found = layer;
+              return entry;
+            }
+        }
+    }
+
+  *found = 0;
+  return baseKey(sc);
+}
+
+// what a press would resolve to now, without recording it
+uint16_t keymapPeek(uint8_t sc)
+{
+  uint8_t layer;
+
+  return lookup(sc, &layer);
+}
+
+// resolve a pressed key and remember the layer it was found on
+uint16_t keymapPress(uint8_t sc)
+{
+  uint8_t layer;
+  uint8_t shift = (sc & 3) << 1;
+  uint16_t entry = lookup(sc, &layer);
+
+  keyLayer[sc >> 2] = (keyLayer[sc >> 2] & ~(3 << shift)) | (layer << shift);
+
+  // one-shot layers are used up by the first other key:
+  if (entry && (entry >> 8) != KC_LAYER)
+    layerOneShot = 0;
+
+  return entry;
+}
+
+// resolve a released key on the layer it was pressed on.
+// layer 0 is looked up again: translate.c releases held keys
+// before the remap, the layout or the profile change, and presses
+// them again with this after it. no side effects.
+uint16_t keymapRelease(uint8_t sc)
+{
+  uint8_t layer = (keyLayer[sc >> 2] >> ((sc & 3) << 1)) & 3;
+
+  if (layer == 0)
+    return baseKey(sc);
+
+  return tableEntry(layer, sc);
+}
+
+// handle the value of a KC_LAYER entry
+void keymapAction(uint8_t code, uint8_t keyUp)
+{
+  uint8_t bit = 1 << (code & 3);
+
+  switch (code & 0x0c)
+    {
+    case 0x00:
+      if (keyUp)
+        layerMomentary &= ~bit;
+      else
+        layerMomentary |= bit;
+      break;
+
+    case 0x04:
+      if (!keyUp)
+        layerToggle ^= bit;
+      break;
+
+    case 0x08:
+      if (!keyUp)
+        layerOneShot |= bit;
+      break;
+
+      // profiles are switched by keymapProfile()
+    }
+}
+
+#ifdef WITH_PROFILES
+// switch to profile n, returns 0 if there's no such profile
+uint8_t keymapProfile(uint8_t n)
+{
+  const KeymapDelta *d;
+  uint8_t i, sc;
+
+  if (n >= KEYMAP_PROFILES)
+    return 0;
+
+  for (i = 0; i < sizeof profileBits; i++)
+    profileBits[i] = 0;
+
+  profileDelta = (const KeymapDelta *)pgm_read_ptr(&keymapProfiles[n]);
+  for (d = profileDelta; (sc = pgm_read_byte(&(d -> sc))) != 0xff; d++)
+    profileBits[sc >> 3] |= 1 << (sc & 7);
+
+  profile = n;
+  return 1;
+}
+
+uint8_t keymapProfileActive()
+{
+  return profile;
+}
+
+// profile saved last time, blank EEPROM is profile 0
+void keymapInit()
+{
+  profileSaved = eeprom_read_byte(&eeProfile);
+  if (!keymapProfile(profileSaved))
+    keymapProfile(0);
+}
+
+// save a profile change once the EEPROM is free, never waits
+void keymapPoll()
+{
+  if (profile != profileSaved && eeprom_is_ready())
+    {
+      eeprom_update_byte(&eeProfile, profile);
+      profileSaved = profile;
+    }
+}
+#endif
+
+// select the layout delta for the layout byte of the keyboard
+void keymapLayout(uint8_t code)
+{
+  const KeymapLayout *kl;
+  const uint8_t *d;
+  uint8_t i, sc;
+
+  layoutDelta = 0;
+  for (i = 0; i < sizeof layoutBits; i++)
+    layoutBits[i] = 0;
+
+  for (kl = keymapLayouts; kl < keymapLayouts + sizeof keymapLayouts / sizeof *kl; kl++)
+    {
+      if (code >= pgm_read_byte(&(kl -> first)) && code <= pgm_read_byte(&(kl -> last)))
+        {
+          layoutDelta = (const uint8_t *)pgm_read_ptr(&(kl -> delta));
+          break;
+        }
+    }
+
+  if (layoutDelta == 0)
+    return;
+
+  for (d = layoutDelta; (sc = pgm_read_byte(d)) != 0xff; d += 2)
+    layoutBits[sc >> 3] |= 1 << (sc & 7);
+}
+
+#ifdef WITH_COMBO
+// can the key be part of a combo?
+uint8_t keymapComboKey(uint8_t sc)
+{
+  return pgm_read_byte(&comboKeys[sc >> 3]) & (1 << (sc & 7));
+}
+#endif
+
+#if defined WITH_COMBO || defined WITH_LEADER
+
+// entry at the end of n keys in a sequence trie, 0 if there's none.
+// *more is set if longer sequences start with the same keys.
+// at most SEQUENCE_KEYS levels, each a scan over the keys that follow.
+static uint16_t trieWalk(const SequenceNode *trie, uint8_t count,
+                         const uint8_t *keys, uint8_t n, uint8_t *more)
+{
+  const SequenceNode *node = 0;
+  uint8_t first = 0;
+  uint8_t i;
+
+  *more = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      for (node = trie + first; count; node++, count--)
+        {
+          if (pgm_read_byte(&(node -> key)) == keys[i])
+            break;
+        }
+
+      if (count == 0)
+        return 0;
+
+      first = pgm_read_byte(&(node -> first));
+      count = pgm_read_byte(&(node -> count));
+    }
+
+  if (node == 0)
+    return 0;
+
+  *more = count != 0;
+  return pgm_read_word(&(node -> entry));
+}
+#endif
+
+#ifdef WITH_COMBO
+// combo of n scancodes, sorted
+uint16_t keymapCombo(const uint8_t *keys, uint8_t n, uint8_t *more)
+{
+  return trieWalk(comboTrie, COMBO_ROOTS, keys, n, more);
+}
+#endif
+
+#ifdef WITH_LEADER
+// leader sequence of n usages, in the order typed
+uint16_t keymapLeader(const uint8_t *keys, uint8_t n, uint8_t *more)
+{
+  return trieWalk(leaderTrie, LEADER_ROOTS, keys, n, more);
+}
+#endif
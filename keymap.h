@@ -0,0 +1,92 @@
+#ifndef KEYMAP_HEADER_H
+# define KEYMAP_HEADER_H
+
+#include <stdint.h>
+
+// KEYMAP_PROFILES and KEYMAP_LAYERS come with the generated tables.
+// at most 4 layers, the layer a key was pressed on is kept in 2 bits.
+// at most 4 profiles, the ones above 0 are deltas against profile 0.
+
+// table entries are 16 bit: class in the high byte, value in the low.
+// a 0 entry is no key on layer 0 and transparent above it.
+#define KC_NORMAL      0   // usage
+#define KC_MODIFIER    1   // modifier bit mask
+#define KC_MACRO       2   // macro number
+#define KC_CONSUMER    3   // consumer usage
+#define KC_SYSTEM      4   // system control usage
+#define KC_LAYER       5   // layer action
+#define KC_PROTOCOL    6   // command byte for the keyboard
+#define KC_TAPHOLD     7   // dual-role key, index into the taphold.c table
+#define KC_MOUSE       8   // mouse key, see below
+#define KC_CLASSES     9
+
+#define KEYMAP_ENTRY(cls, value)  (((uint16_t)(cls) << 8) | (value))
+
+// layer actions:
+#define KEYMAP_MO(n)   KEYMAP_ENTRY(KC_LAYER, 0x00 + (n))   // momentary, while held
+#define KEYMAP_TG(n)   KEYMAP_ENTRY(KC_LAYER, 0x04 + (n))   // toggle on press
+#define KEYMAP_OSL(n)  KEYMAP_ENTRY(KC_LAYER, 0x08 + (n))   // one-shot, for the next key only
+#define KEYMAP_PROFILE(n)  KEYMAP_ENTRY(KC_LAYER, 0x0c + (n))   // switch to profile n
+
+// keys in a combo or leader sequence, see combo.c and leader.c
+#define SEQUENCE_KEYS  3
+
+// trie node, the children are first .. first + count - 1
+typedef struct
+{
+  uint8_t key;
+  uint8_t first;
+  uint8_t count;
+  uint16_t entry;
+} SequenceNode;
+
+// mouse keys: a movement with direction bits, a button or a wheel step
+#define MOUSE_UP       0x01
+#define MOUSE_DOWN     0x02
+#define MOUSE_LEFT     0x04
+#define MOUSE_RIGHT    0x08
+#define MOUSE_BUTTON   0x10   // | 1 << (button - 1)
+#define MOUSE_WHEEL    0x20   // + 0 up, + 1 down
+
+typedef struct
+{
+  uint8_t first;
+  uint8_t last;
+  const uint8_t *delta;
+} KeymapLayout;
+
+// profile entry that differs from profile 0, lists end at sc 0xff
+typedef struct
+{
+  uint8_t sc;
+  uint8_t layer;
+  uint16_t entry;
+} KeymapDelta;
+
+#ifdef WITH_PROFILES
+void keymapInit(void);
+void keymapPoll(void);
+uint8_t keymapProfile(uint8_t n);
+uint8_t keymapProfileActive(void);
+#else
+// profile 0 only, the deltas are left out
+# define keymapInit()
+# define keymapPoll()
+# define keymapProfileActive()  0
+#endif
+uint16_t keymapPeek(uint8_t sc);
+uint16_t keymapPress(uint8_t sc);
+uint16_t keymapRelease(uint8_t sc);
+uint16_t keymapUsage(uint8_t usage);
+void keymapAction(uint8_t code, uint8_t keyUp);
+uint8_t keymapLayer(void);
+void keymapLayout(uint8_t code);
+#ifdef WITH_COMBO
+uint8_t keymapComboKey(uint8_t sc);
+uint16_t keymapCombo(const uint8_t *keys, uint8_t n, uint8_t *more);
+#endif
+#ifdef WITH_LEADER
+uint16_t keymapLeader(const uint8_t *keys, uint8_t n, uint8_t *more);
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Keystroke latency, from the start bit on the keyboard line to the
+ * IN token that takes the report.
+ *
+ * The receive interrupt keeps the timer 1 count of every byte. One
+ * key byte at a time is followed: the first report a key edge changed
+ * after it was taken from the receive buffer, and the moment the driver's
+ * buffer is free again, which the main loop sees right after the
+ * USB interrupt woke it. The link itself is a constant 9.5 bits,
+ * start bit to the middle of the stop bit.
+ */
+#include "sun_defs.h"
+#include "timer.h"
+#include "latency.h"
+
+#define LINK_TICKS  (TIMER_TICKS_PER_US * 9500000L / USART_BAUDRATE)
+
+LatencyStats latencyStats;
+
+static uint32_t keyStamp;   // receive interrupt of the key followed
+static uint32_t sentStamp;
+static uint8_t state = 0;
+
+#define LATENCY_IDLE     0
+#define LATENCY_KEY      1   // waiting for a report
+#define LATENCY_SENT     2   // waiting for the host to take it
+
+static void count(uint16_t *histogram, uint32_t ticks)
+{
+  uint8_t b = 0;
+
+  // 256 us units
+  ticks >>= 9;
+  while (ticks && b < LATENCY_BUCKETS - 1)
+    {
+      ticks >>= 1;
+      b++;
+    }
+
+  if (histogram[b] != 0xffff)
+    histogram[b]++;
+}
+
+// a key byte taken from the receive buffer, with its interrupt's count
+void latencyKey(uint16_t rxTicks)
+{
+  uint32_t now;
+
+  if (state != LATENCY_IDLE)
+    return;
+
+  now = timerStamp();
+  keyStamp = now - (uint16_t)((uint16_t)now - rxTicks);
+  state = LATENCY_KEY;
+}
+
+// a report changed by a key edge was handed to the driver
+void latencySent()
+{
+  if (state != LATENCY_KEY)
+    return;
+
+  sentStamp = timerStamp();
+  count(latencyStats.loop, sentStamp - keyStamp);
+  state = LATENCY_SENT;
+}
+
+// every main loop pass, this also keeps timerStamp() going
+void latencyPoll()
+{
+  uint32_t now = timerStamp();
+
+  if (state != LATENCY_SENT || !usbInterruptIsReady())
+    return;
+
+  count(latencyStats.host, now - sentStamp);
+  count(latencyStats.total, now - keyStamp + LINK_TICKS);
+  state = LATENCY_IDLE;
+}
+
+void latencyClear()
+{
+  uint8_t i;
+
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    latencyStats.loop[i] = latencyStats.host[i] = latencyStats.total[i] = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef LATENCY_HEADER_H
+# define LATENCY_HEADER_H
+
+#include <stdint.h>
+
+// bucket 0 is below 256 us, bucket n from 256 us << (n - 1),
+// the last one takes everything from 16 ms on, past the 10 ms
+// interrupt poll interval.
+#define LATENCY_BUCKETS  8
+
+// histograms read by VREQ_LATENCY_GET, counts stop at 0xffff
+typedef struct
+{
+  uint16_t loop[LATENCY_BUCKETS];    // receive interrupt to report queued
+  uint16_t host[LATENCY_BUCKETS];    // report queued to taken by the host
+  uint16_t total[LATENCY_BUCKETS];   // start bit to taken by the host
+} LatencyStats;
+
+extern LatencyStats latencyStats;
+
+#ifdef WITH_LATENCY
+void latencyKey(uint16_t rxTicks);
+void latencySent(void);
+void latencyPoll(void);
+void latencyClear(void);
+#else
+# define latencySent()
+# define latencyPoll()
+#endif
+
+#endif
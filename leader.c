@@ -0,0 +1,95 @@
+/*
+ * Leader sequences: tap the leader key, then type a few keys.
+ *
+ * Every key pressed while a sequence is active walks the leader trie
+ * from keymap.c with the keys typed so far. Keys are swallowed only as
+ * long as they are a prefix of some sequence. The first one that isn't
+ * ends the sequence: the keys swallowed before it are typed after all,
+ * then it goes to the host as usual. A complete sequence is replaced by
+ * its entry, one that is also the start of a longer sequence fires
+ * when the timeout is over. Only plain usages take part, modifiers and
+ * layer keys pass through.
+ */
+#include "keymap.h"
+#include "events.h"
+#include "leader.h"
+
+uint8_t leaderActive = 0;
+
+static uint8_t keys[SEQUENCE_KEYS];
+static uint8_t count;
+static uint16_t since;
+
+// entry of the keys so far, fired on timeout
+static uint16_t matched;
+
+void leaderStart(uint16_t now)
+{
+  leaderActive = 1;
+  count = 0;
+  matched = 0;
+  since = now;
+}
+
+// the first n keys swallowed go out as taps, ahead of anything
+// queued behind them
+static void replay(uint8_t n)
+{
+  while (n--)
+    {
+      eventPutFirst(EVENT_KEY(KEYMAP_ENTRY(KC_NORMAL, keys[n]), 1));
+      eventPutFirst(EVENT_KEY(KEYMAP_ENTRY(KC_NORMAL, keys[n]), 0));
+    }
+}
+
+// key sc pressed while the sequence is active. returns the entry to
+// dispatch for it, 0 if it was swallowed or put back behind the keys
+// swallowed before it.
+uint16_t leaderKey(uint8_t sc, uint16_t entry, uint16_t now)
+{
+  uint8_t more;
+  uint16_t found;
+
+  if ((entry >> 8) != KC_NORMAL || entry == 0)
+    return entry;
+
+  keys[count++] = entry;
+  found = keymapLeader(keys, count, &more);
+
+  if (more && count < SEQUENCE_KEYS)
+    {
+      matched = found;
+      since = now;
+      return 0;
+    }
+
+  leaderActive = 0;
+  if (found)
+    {
+      eventPutFirst(EVENT_KEY(found, 1));
+      return found;
+    }
+
+  // no sequence starts like this
+  if (count == 1)
+    return entry;
+
+  eventPutFirst(sc);
+  replay(count - 1);
+  return 0;
+}
+
+void leaderPoll(uint16_t now)
+{
+  if (!leaderActive || (uint16_t)(now - since) < LEADER_TIMEOUT)
+    return;
+
+  leaderActive = 0;
+  if (matched)
+    {
+      eventPutFirst(EVENT_KEY(matched, 1));
+      eventPutFirst(EVENT_KEY(matched, 0));
+    }
+  else
+    replay(count);
+}
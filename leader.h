@@ -0,0 +1,28 @@
+#ifndef LEADER_HEADER_H
+# define LEADER_HEADER_H
+
+#include <stdint.h>
+
+// the leader is a tap of this key, Help is Fn when held
+#define LEADER_KEY  SKBD_HELP
+
+// sequence abandoned after this many ms without a key
+#ifndef LEADER_TIMEOUT
+# define LEADER_TIMEOUT  1000
+#endif
+
+#ifdef WITH_LEADER
+extern uint8_t leaderActive;
+
+void leaderStart(uint16_t now);
+uint16_t leaderKey(uint8_t sc, uint16_t entry, uint16_t now);
+void leaderPoll(uint16_t now);
+#else
+// a tap of Help is only a tap
+# define leaderActive                0
+# define leaderStart(now)
+# define leaderKey(sc, entry, now)   (entry)
+# define leaderPoll(now)
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Status LEDs, stepped through PROGMEM patterns.
+ *
+ * Callers only start a pattern, the scheduler steps it every LED_TICK
+ * ms. Starting a pattern sets the LED right away, so a flash costs no
+ * more than a port write.
+ */
+#include <avr/pgmspace.h>
+
+#include "sun_defs.h"
+#include "led.h"
+
+PROGMEM const uint8_t ledFlash[] = {
+  LED_ON | 5, LED_END
+};
+
+PROGMEM const uint8_t ledBlink[] = {
+  LED_ON | 20, LED_OFF | 20, LED_LOOP
+};
+
+// blink code 2: the event queue was full and a key got lost
+PROGMEM const uint8_t ledOverflow[] = {
+  LED_ON | 15, LED_OFF | 15, LED_ON | 15, LED_OFF | 100, LED_END
+};
+
+typedef struct
+{
+  const uint8_t *pattern;   // 0 if off
+  uint8_t step;
+  uint8_t left;             // ticks of the current step
+} Led;
+
+static Led leds[LEDS];
+
+static void ledSet(uint8_t led, uint8_t on)
+{
+  uint8_t bit = 1 << (PB1 + led);
+
+  if (on)
+    PORTB |= bit;
+  else
+    PORTB &= ~bit;
+}
+
+// set the LED for the current step, ends or loops the pattern
+static void ledApply(uint8_t led)
+{
+  Led *l = &leds[led];
+  uint8_t s = pgm_read_byte(&l -> pattern[l -> step]);
+
+  if ((s & ~LED_ON) == 0)
+    {
+      if (s == LED_END)
+        {
+          ledStop(led);
+          return;
+        }
+      l -> step = 0;
+      s = pgm_read_byte(l -> pattern);
+    }
+
+  ledSet(led, s & LED_ON);
+  l -> left = s & ~LED_ON;
+}
+
+void ledStart(uint8_t led, const uint8_t *pattern)
+{
+  leds[led].pattern = pattern;
+  leds[led].step = 0;
+  ledApply(led);
+}
+
+void ledStop(uint8_t led)
+{
+  leds[led].pattern = 0;
+  ledSet(led, 0);
+}
+
+void ledTask(uint16_t now)
+{
+  uint8_t i;
+  Led *l;
+
+  for (i = 0; i < LEDS; i++)
+    {
+      l = &leds[i];
+      if (l -> pattern == 0 || --l -> left)
+        continue;
+
+      l -> step++;
+      ledApply(i);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef LED_HEADER_H
+# define LED_HEADER_H
+
+#include <stdint.h>
+
+// debug LEDs on port B
+#define LED_ACTIVITY  0   // PB1, a flash per report
+#define LED_MACRO     1   // PB2, blinks while a macro plays
+#define LED_ERROR     2   // PB3, blink codes
+#define LEDS          3
+
+// pattern steps: on or off for 1..127 ticks of LED_TICK ms.
+// LED_END switches the LED off, LED_LOOP starts over.
+#define LED_TICK  10
+#define LED_ON    0x80
+#define LED_OFF   0x00
+#define LED_END   0x00
+#define LED_LOOP  0x80
+
+extern const uint8_t ledFlash[];
+extern const uint8_t ledBlink[];
+extern const uint8_t ledOverflow[];
+
+void ledStart(uint8_t led, const uint8_t *pattern);
+void ledStop(uint8_t led);
+void ledTask(uint16_t now);
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * Macro playback.
+ *
+ * Macros are PROGMEM lists of steps, played back one report at a time
+ * from the main loop. Strings are read directly from flash and typed
+ * through the typing tables, nothing is copied to RAM.
+ *
+ * The macro never writes the live report. Its output is kept as an
+ * overlay (modifiers + one key) which is merged in when a report is
+ * built, so keys the user is holding stay pressed. Nested or
+ * overlapping macros get their own frame on a small stack, the frame
+ * keeps the position and the modifiers held by that macro.
+ */
+#include <avr/pgmspace.h>
+
+#include "sun_defs.h"
+#include "typing.h"
+#include "macro.h"
+
+static const MacroStep macroFindKey[] PROGMEM = {
+  {MACRO_TAP, USB_MOD_LCTRL, 0x09}, {MACRO_END}       // ctrl + f
+};
+static const MacroStep macroAgain[] PROGMEM = {
+  {MACRO_TAP, 0, 0x3E}, {MACRO_END}                   // f5
+};
+static const MacroStep macroCopy[] PROGMEM = {
+  {MACRO_TAP, USB_MOD_LCTRL, 0x06}, {MACRO_END}       // ctrl + c
+};
+static const MacroStep macroOpen[] PROGMEM = {
+  {MACRO_TAP, USB_MOD_LCTRL, 0x12}, {MACRO_END}       // ctrl + o
+};
+static const MacroStep macroPaste[] PROGMEM = {
+  {MACRO_TAP, USB_MOD_LCTRL, 0x19}, {MACRO_END}       // ctrl + v
+};
+static const MacroStep macroCut[] PROGMEM = {
+  {MACRO_TAP, USB_MOD_LCTRL, 0x1B}, {MACRO_END}       // ctrl + x
+};
+static const MacroStep macroFront[] PROGMEM = {
+  {MACRO_TAP, 0, 0x4A}, {MACRO_END}                   // home(?)
+};
+static const MacroStep macroUndo[] PROGMEM = {
+  {MACRO_TAP, USB_MOD_LCTRL, 0x1D}, {MACRO_END}       // ctrl + z
+};
+static const MacroStep macroProps[] PROGMEM = {
+  {MACRO_TAP, 0, 0x65}, {MACRO_END}                   // win context menu
+};
+
+// boilerplate typed by fn + again:
+static const char textSignature[] PROGMEM = "Best regards,\n";
+static const MacroStep macroSignature[] PROGMEM = {
+  {MACRO_STRING, 0, TYPING_US, textSignature}, {MACRO_END}
+};
+
+// macros by number, MACRO(n) in sun.keymap:
+static const MacroStep * const macroList[] PROGMEM = {
+  macroFindKey,         // 0
+  macroAgain,           // 1
+  macroCopy,            // 2
+  macroOpen,            // 3
+  macroPaste,           // 4
+  macroCut,             // 5
+  macroFront,           // 6
+  macroUndo,            // 7
+  macroProps,           // 8
+  macroSignature,       // 9
+};
+
+typedef struct
+{
+  const MacroStep *step;
+  const char *text;
+  uint8_t mods;
+} MacroFrame;
+
+static MacroFrame stack[MACRO_DEPTH];
+static uint8_t depth = 0;
+
+// macro requested by a key handler, taken by the next macroStep().
+// both run in the main loop.
+static uint8_t requested = 0;
+static const MacroStep *requestSeq;
+
+// the overlay merged into the report:
+static uint8_t overlayMods = 0;
+static uint8_t overlayKey = 0;
+
+static uint8_t next = 0;      // usage waiting to be pressed
+static uint8_t nextMod = 0;
+static uint8_t space = 0;     // dead key typed, space follows
+
+// macro number n, 0 if there's no such macro
+const MacroStep *macroGet(uint8_t n)
+{
+  if (n >= sizeof macroList / sizeof *macroList)
+    return 0;
+
+  return (const MacroStep *)pgm_read_ptr(&macroList[n]);
+}
+
+// request playback, the main loop picks it up with the next step.
+// dropped if the previous request wasn't taken yet.
+void macroStart(const MacroStep *seq)
+{
+  if (requested || seq == 0)
+    return;
+
+  requestSeq = seq;
+  requested = 1;
+}
+
+// save the current frame and start the macro on top of it.
+// the new frame inherits the modifiers held so far.
+static void push(const MacroStep *seq)
+{
+  MacroFrame *f;
+
+  if (depth == MACRO_DEPTH)
+    return;
+
+  f = &stack[depth];
+  f -> step = seq;
+  f -> text = 0;
+  f -> mods = depth ? stack[depth - 1].mods : 0;
+  depth++;
+}
+
+// fetch the next usage to press, 0 once all frames are done
+static uint8_t fetchKey(uint8_t *modifier)
+{
+  MacroFrame *f;
+  const MacroStep *s;
+  uint8_t key, c;
+
+  if (space)
+    {
+      space = 0;
+      *modifier = 0;
+      return USB_KEY_SPACE;
+    }
+
+  while (depth)
+    {
+      f = &stack[depth - 1];
+      s = f -> step;
+
+      switch (pgm_read_byte(&(s -> type)))
+        {
+        case MACRO_TAP:
+          *modifier = pgm_read_byte(&(s -> modifier));
+          key = pgm_read_byte(&(s -> key));
+          f -> step++;
+          return key;
+
+        case MACRO_STRING:
+          if (f -> text == 0)
+            f -> text = (const char *)pgm_read_ptr(&(s -> data));
+
+          c = pgm_read_byte(f -> text++);
+          if (c == 0)
+            {
+              f -> text = 0;
+              f -> step++;
+              break;
+            }
+
+          key = typingLookup(pgm_read_byte(&(s -> key)), c, modifier);
+          if (key & TYPING_DEAD)
+            {
+              space = 1;
+              key &= ~TYPING_DEAD;
+            }
+          if (key)
+            return key;
+          break;
+
+        case MACRO_MODS:
+          f -> mods = pgm_read_byte(&(s -> modifier));
+          f -> step++;
+          break;
+
+        case MACRO_CALL:
+          f -> step++;
+          push((const MacroStep *)pgm_read_ptr(&(s -> data)));
+          break;
+
+          // end of this macro, back to the saved frame:
+        default:
+          depth--;
+          break;
+        }
+    }
+
+  return 0;
+}
+
+// advance the macro overlay by one step.
+// return 1 if the overlay changed and a report has to be sent.
+uint8_t macroStep(void)
+{
+  uint8_t mods;
+
+  if (requested)
+    {
+      push(requestSeq);
+      requested = 0;
+    }
+
+  if (next == 0 && depth)
+    next = fetchKey(&nextMod);
+
+  mods = depth ? stack[depth - 1].mods : 0;
+
+  // a key is only released if the next one is the same
+  // or the macro is done, otherwise the press replaces it:
+  if (overlayKey && (overlayKey == next || next == 0))
+    {
+      overlayKey = 0;
+      overlayMods = mods;
+      return 1;
+    }
+
+  if (next == 0)
+    {
+      // release the modifiers held by finished frames:
+      if (overlayMods == mods)
+        return 0;
+
+      overlayMods = mods;
+      return 1;
+    }
+
+  overlayMods = mods | nextMod;
+  overlayKey = next;
+  next = 0;
+
+  return 1;
+}
+
+// 1 until the last step of the macro is sent
+uint8_t macroPlaying(void)
+{
+  return requested || depth || next || overlayKey;
+}
+
+// merge the overlay into a copy of the live report
+void macroOverlay(uint8_t *report, uint8_t len)
+{
+  uint8_t i;
+
+  report[1] |= overlayMods;
+
+  if (overlayKey == 0)
+    return;
+
+  for (i = 2; i < len; i++)
+    {
+      if (report[i] == overlayKey)
+        return;
+    }
+
+  for (i = 2; i < len; i++)
+    {
+      if (report[i] == 0)
+        {
+          report[i] = overlayKey;
+          return;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef MACRO_HEADER_H
+# define MACRO_HEADER_H
+
+#include <stdint.h>
+
+// macro step types:
+#define MACRO_END      0
+#define MACRO_TAP      1   // press and release modifier + key
+#define MACRO_STRING   2   // type a PROGMEM string, key is the typing layout
+#define MACRO_MODS     3   // hold modifiers for the rest of the macro
+#define MACRO_CALL     4   // play a nested macro
+
+// nesting depth of the save/restore stack:
+#define MACRO_DEPTH    4
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t modifier;
+  uint8_t key;
+  const void *data;     // string for MACRO_STRING, macro for MACRO_CALL
+} MacroStep;
+
+#ifdef WITH_MACRO
+const MacroStep *macroGet(uint8_t n);
+void macroStart(const MacroStep *seq);
+uint8_t macroStep(void);
+uint8_t macroPlaying(void);
+void macroOverlay(uint8_t *report, uint8_t len);
+#else
+// macro keys do nothing
+# define macroGet(n)                0
+# define macroStart(seq)
+# define macroStep()                0
+# define macroPlaying()             0
+# define macroOverlay(report, len)
+#endif
+
+#endif
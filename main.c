@@ -1,24 +1,127 @@
 /*
   Michal Kowalik, 2016
  */
+#include <avr/sleep.h>
+
 #include "sun_defs.h"
-#include "keycodes.h"
-#include "utils.h"
+#include "keymap.h"
+#include "led.h"
+#include "remap.h"
+#include "timer.h"
+#include "events.h"
+#include "turbo.h"
+#include "consumer.h"
+#include "mouse.h"
+#include "sunmouse.h"
+#include "sched.h"
+#include "latency.h"
+#include "counters.h"
+#include "trace.h"
+#include "stack.h"
+#include "translate.h"
+
+// bytes from the keyboard, filled by the USART interrupt
+#define RX_SIZE  8
+
+static volatile uint8_t rxBuf[RX_SIZE];
+#ifdef WITH_LATENCY
+static volatile uint16_t rxTicks[RX_SIZE];   // timer 1 at the interrupt
+#endif
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
 
-static int newUsartByte = 0;
 //static report_keyboard keyReportBuffer;
 volatile static uchar LED_state = 0xff;
 
-static uint8_t report[] = {0, 0, 0, 0, 
-                           0, 0, 0, 0};
+// report as sent to the host: live state + macro overlay
+static uint8_t reportOut[KEYBOARD_REPORT_SIZE];
+
+#ifdef WITH_CONSUMER
+// consumer report as sent last: [id][usage low][usage high]
+static uint8_t consumerOut[] = {REPORT_ID_CONSUMER, 0, 0};
+#endif
+
+#ifdef WITH_MOUSE
+// mouse report as sent last, interface 1
+static uint8_t mouseOut[MOUSE_REPORT_SIZE];
+#endif
+
+#define INTERFACE_MOUSE  1
+
+// keyboard on interface 0 and endpoint 1, mouse on interface 1
+// and endpoint 3. the HID descriptors are served from in here.
+PROGMEM const char usbDescriptorConfiguration[USB_CFG_DESCR_PROPS_CONFIGURATION] = {
+    9, USBDESCR_CONFIG,
+    USB_CFG_DESCR_PROPS_CONFIGURATION, 0,   // total length
+    USB_CFG_HAVE_INTRIN_ENDPOINT3 + 1,      // interfaces
+    1, 0,                                   // configuration value, no string
+    (1 << 7),                               // bus powered
+    USB_CFG_MAX_BUS_POWER / 2,
+
+    // interface 0: keyboard and consumer control
+    9, USBDESCR_INTERFACE, 0, 0, 1,
+    USB_CFG_INTERFACE_CLASS, USB_CFG_INTERFACE_SUBCLASS, USB_CFG_INTERFACE_PROTOCOL, 0,
+    9, USBDESCR_HID, 0x01, 0x01, 0x00, 1, USBDESCR_HID_REPORT,   // offset 18
+    USB_CFG_HID_REPORT_DESCRIPTOR_LENGTH, 0,
+    7, USBDESCR_ENDPOINT, (char)0x81, 0x03, 8, 0, USB_CFG_INTR_POLL_INTERVAL,
+
+#ifdef WITH_MOUSE
+    // interface 1: mouse
+    9, USBDESCR_INTERFACE, INTERFACE_MOUSE, 0, 1,
+    3, 0, 0, 0,                             // HID, no boot protocol
+    9, USBDESCR_HID, 0x01, 0x01, 0x00, 1, USBDESCR_HID_REPORT,   // offset 43
+    MOUSE_REPORT_DESCRIPTOR_LENGTH, 0,
+    7, USBDESCR_ENDPOINT, (char)(0x80 | USB_CFG_EP3_NUMBER), 0x03, 8, 0, USB_CFG_INTR_POLL_INTERVAL,
+#endif
+};
+
+// HID and report descriptors of the interface in wIndex
+usbMsgLen_t usbFunctionDescriptor(struct usbRequest *rq)
+{
+#ifdef WITH_MOUSE
+  uchar mouse = rq -> wIndex.bytes[0] == INTERFACE_MOUSE;
+#else
+  uchar mouse = 0;
+#endif
+
+  if (rq -> wValue.bytes[1] == USBDESCR_HID)
+    {
+      usbMsgPtr = (usbMsgPtr_t)(usbDescriptorConfiguration + (mouse ? 43 : 18));
+      return 9;
+    }
 
-// repeat rate for keyboards
+  if (rq -> wValue.bytes[1] == USBDESCR_HID_REPORT)
+    {
+#ifdef WITH_MOUSE
+      if (mouse)
+        {
+          usbMsgPtr = (usbMsgPtr_t)mouseReportDescriptor;
+          return MOUSE_REPORT_DESCRIPTOR_LENGTH;
+        }
+#endif
+      usbMsgPtr = (usbMsgPtr_t)usbHidReportDescriptor;
+      return USB_CFG_HID_REPORT_DESCRIPTOR_LENGTH;
+    }
+
+  return 0;
+}
+
+// one byte replies to vendor and class requests
+static uchar vendorReply;
+
+// repeat rate for keyboards, 4 ms units
 static uchar idleRate;
+static uchar idleCounter = 0;
+
+// the keyboard report is to be sent
+static uint8_t updateNeeded = 0;
+static uint8_t heldBack = 0;
 
-// set if replaying macro:
-// if set and macro replying done -> clean the buffer, remove all the
-// modifiers or saved keys.
-static uint8_t macroReplay = 0;
+// time asleep in the current load period, timer 1 ticks, and the
+// share of the last period the CPU was awake
+#define LOAD_PERIOD  250
+static uint32_t sleptTicks = 0;
+static uint8_t activePercent = 100;
 
 // send byte to keyb:
 static void uart_putchar(uchar c)
@@ -27,6 +130,13 @@ static void uart_putchar(uchar c)
   UDR = c;
 }
 
+// command from a key, dropped if the transmitter is busy
+void keyboardSend(uint8_t cmd)
+{
+  if (bit_is_set(UCSRA, UDRE))
+    UDR = cmd;
+}
+
 
 usbMsgLen_t usbFunctionSetup(uchar data[8]) 
 {
@@ -36,185 +146,149 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
     {
       switch(rq -> bRequest) 
         {
-          // send "no keys pressed" if asked here
+          // send the current state if asked here
         case USBRQ_HID_GET_REPORT:
-          if(rq -> wValue.bytes[0] == 1)
+#ifdef WITH_MOUSE
+          if(rq -> wIndex.bytes[0] == INTERFACE_MOUSE)
             {
-              // send no key -- no modifier, no keystroke
-              report[0] = 0;
-              report[2] = 0;
-              usbMsgPtr = &report;
-              return sizeof report;
+              usbMsgPtr = (usbMsgPtr_t)mouseOut;
+              return sizeof mouseOut;
+            }
+          else
+#endif
+          if(rq -> wValue.bytes[0] == REPORT_ID_KEYBOARD)
+            {
+              translateReport(reportOut);
+              usbMsgPtr = (usbMsgPtr_t)reportOut;
+              return sizeof reportOut;
             } 
+#ifdef WITH_CONSUMER
+          else if(rq -> wValue.bytes[0] == REPORT_ID_CONSUMER)
+            {
+              usbMsgPtr = (usbMsgPtr_t)consumerOut;
+              return sizeof consumerOut;
+            }
+#endif
           else 
             //no such descriptor:
             return 0;
           
-        // if wLength == 1 -> led state
+        // led state, with or without the report ID in front
         case USBRQ_HID_SET_REPORT:
-          return (rq -> wLength.word == 1) ? USB_NO_MSG : 0;
+          return (rq -> wLength.word == 1 || rq -> wLength.word == 2) ? USB_NO_MSG : 0;
 
-          // set idle rate:
+          // the idle rate is the keyboard's, the mouse only reports
+          // changes: its rate reads 0, infinite, whatever it is set to
         case USBRQ_HID_GET_IDLE:
-          usbMsgPtr = &idleRate;
+          vendorReply = 0;
+          usbMsgPtr = rq -> wIndex.bytes[0] == INTERFACE_MOUSE ? &vendorReply : &idleRate;
           return 1;
 
           // save idle rate as required by spec:
         case USBRQ_HID_SET_IDLE:
-          idleRate = rq -> wValue.bytes[1];
+          if(rq -> wIndex.bytes[0] != INTERFACE_MOUSE)
+            idleRate = rq -> wValue.bytes[1];
           return 0;
         }
     }
 
-  // default:
-  return 0;
-}
+  if((rq -> bmRequestType & USBRQ_TYPE_MASK) == USBRQ_TYPE_VENDOR)
+    {
+      switch(rq -> bRequest)
+        {
+#ifdef WITH_REMAP
+          // keys are looked up in the main loop too, no locking.
+          // a full table gets no status stage, the request fails.
+        case VREQ_REMAP_SET:
+          return translateRemap(rq -> wValue.bytes[0], rq -> wValue.bytes[1]) ? 0 : USB_NO_MSG;
+
+        case VREQ_REMAP_CLEAR:
+          translateRemapClear();
+          return 0;
 
-// handle left side rows of special function keys:
-// return 0 if no macro key was pressed, 1 otherwise.
-// set the usb report buffer:
-uint8_t macroKey(uchar rb)
-{
-  uint8_t modifier = 0;
-  uint8_t key = 0;
+        case VREQ_REMAP_GET:
+          usbMsgPtr = (usbMsgPtr_t)remapTable;
+          return remapCount * 2;
+#endif
 
-  switch(rb)
-    {
-      // ctrl + f
-    case SKBD_FIND:
-      key = 0x09;
-      modifier = 1;
-      break;
-
-      // f5:
-    case SKBD_AGAIN:
-      key = 0x3E;
-      break;
-      
-      // ctrl + c (stop and copy..)
-    case SKBD_STOP:
-    case SKBD_COPY:
-      key = 0x06;
-      modifier = 1;
-      break;
-
-      // ctrl + o for open
-    case SKBD_OPEN:
-      key = 0x12;
-      modifier = 1;
-      break;
-
-      // ctrl + v
-    case SKBD_PASTE:
-      key = 0x19;
-      modifier = 1;
-      break;
-
-    case SKBD_CUT:
-      key = 0x1B;
-      modifier = 1;
-      break;
-
-      // home(?)
-    case SKBD_FRONT:
-      key = 0x4A;
-      break;
-
-      // ctrl + z
-    case SKBD_UNDO:
-      key = 0x1D;
-      modifier = 1;
-      break;
-
-      // win context menu:
-    case SKBD_PROPS:
-      key = 0x65;
-      break;
-
-      // none of interesting keys:
-    default:
-      return 0;
-    }
-  
-  // if we are here, something of an interest happened
-  if(modifier)
-    report[0] |= (1 << 0);
-  
-  report[2] = key;
-  macroReplay = 1;
+#ifdef WITH_PROFILES
+          // switched in order with the keys, like the key combo
+        case VREQ_PROFILE_SET:
+          eventPut(EVENT_KEY(KEYMAP_PROFILE(rq -> wValue.bytes[0] & 3), 0));
+          return 0;
 
-  return 1;
-}
+        case VREQ_PROFILE_GET:
+          vendorReply = keymapProfileActive();
+          usbMsgPtr = &vendorReply;
+          return 1;
+#endif
 
+#ifdef WITH_TURBO
+        case VREQ_TURBO_SET:
+          turboSet(rq -> wValue.bytes[0], rq -> wValue.bytes[1]);
+          return 0;
 
-// build USB report buffer - 
-// based on the array in keycodes.h
-static uchar buildUsbReport(uchar rb) 
-{
+        case VREQ_TURBO_RATE:
+          turboRate(rq -> wValue.word);
+          return 0;
 
-  // 0: key down, key up otherwise
-  uchar keyUp = rb & 0x80;
-  uchar cnt;
+        case VREQ_TURBO_GET:
+          usbMsgPtr = (usbMsgPtr_t)&turboStats;
+          return sizeof turboStats;
+#endif
 
-  uchar usbKey = pgm_read_byte(&(sunkeycodes[rb & 0x7f]));
+#ifdef WITH_MOUSE
+        case VREQ_SUNMOUSE_GET:
+          usbMsgPtr = (usbMsgPtr_t)&sunmouseStats;
+          return sizeof sunmouseStats;
+#endif
 
-  if(usbKey == 0)
-    return 0;
+        case VREQ_SCHED_GET:
+          usbMsgPtr = (usbMsgPtr_t)schedWorst;
+          return sizeof schedWorst;
 
-  // check if macro key:
-  if(macroKey(rb))
-    return 1;
+        case VREQ_LOAD_GET:
+          usbMsgPtr = &activePercent;
+          return 1;
 
-  // check modifier 
-  if ((usbKey >= 0xE0) && (usbKey <= 0xE7)) 
-    {
-      if (keyUp)
-          report[0] &= ~(1 << (usbKey - 0xE0));
-      else 
-          report[0] |= (1 << (usbKey - 0xE0)) ;
-      // return key pressed:
-      return 1;
-    }
+#ifdef WITH_LATENCY
+        case VREQ_LATENCY_GET:
+          usbMsgPtr = (usbMsgPtr_t)&latencyStats;
+          return sizeof latencyStats;
 
-  // check normal keys:
-  if (keyUp) 
-    {
-      for (cnt = 2; cnt < sizeof report; cnt++)
-        {
-          if (report[cnt] == usbKey)
-            {
-              report[cnt] = 0;
-              break;
-            }
-        }
-    }
-  else 
-    {
-      for (cnt = 2; cnt < sizeof report; cnt++)
-        {
-          if (report[cnt] == 0)
-            {
-              report[cnt] = usbKey;
-              break;
-            }
+        case VREQ_LATENCY_CLEAR:
+          latencyClear();
+          return 0;
+#endif
+
+        case VREQ_COUNTERS_GET:
+          usbMsgPtr = (usbMsgPtr_t)&counters;
+          return sizeof counters;
+
+        case VREQ_TRACE_GET:
+          usbMsgPtr = (usbMsgPtr_t)&trace;
+          return sizeof trace;
+
+        case VREQ_STACK_GET:
+          stackScan();
+          usbMsgPtr = (usbMsgPtr_t)&stackStats;
+          return sizeof stackStats;
         }
     }
 
-  // key was pressed
-  return 1;
+  // default:
+  return 0;
 }
 
-// TODO:
-// Check if it may be the part of the problem?
-// there's no ID anywhere here
 usbMsgLen_t usbFunctionWrite(uint8_t * data, uchar len)
 {
   uchar cLED = 0;
 
-  if(data[0] == LED_state)
+  // the LED byte comes last, after the report ID if there is one
+  if(data[len - 1] == LED_state)
     return 1;
   else
-    LED_state = data[0];
+    LED_state = data[len - 1];
 
   if (LED_state & USB_LED_NLOCK) {
     cLED |= 0x01;
@@ -230,6 +304,8 @@ usbMsgLen_t usbFunctionWrite(uint8_t * data, uchar len)
   }
   uart_putchar(SKBDCMD_SETLED);
   uart_putchar(cLED);
+  COUNT(counters.ledCommands);
+  traceAdd(TRACE_LED, cLED, 0);
   return 1;
 }
 
@@ -250,25 +326,151 @@ static int usartInit()
 }
 
 // Interrupt handling:
-// Process bytes coming from the keyboard.
-ISR(USART_RXC_vect)
+// Only queue the bytes coming from the keyboard, they are
+// processed in the main loop. A full buffer drops the byte.
+//
+// V-USB wants every other interrupt to enable interrupts again as
+// its first instruction, but the receive flag stays set until UDR is
+// read. So the vector only switches the receive interrupt off and
+// enables interrupts, the handler below switches it on again.
+ISR(USART_RXC_vect, ISR_NAKED)
+{
+  asm volatile("cbi %0, %1\n\t"
+               "sei\n\t"
+               "rjmp __vector_usart_rx\n\t"
+               :: "I" (_SFR_IO_ADDR(UCSRB)), "I" (RXCIE));
+}
+
+ISR(__vector_usart_rx)
 {
-  char receivedByte;
-    
-  // Fetch the recieved byte value into the variable:
+  uchar status, receivedByte;
+  uchar next = (rxHead + 1) & (RX_SIZE - 1);
+
+  TIMER_WAKE();
+
+  // the error flags belong to the byte in UDR, read them first
+  status = UCSRA;
   receivedByte = UDR;
-  
-  if (buildUsbReport(receivedByte))
-    newUsartByte = 1;
+
+  COUNT(counters.rxBytes);
+  if (status & (1 << DOR))
+    COUNT(counters.overruns);
+
+  if (status & (1 << FE))
+    COUNT(counters.frameErrors);
+  else if (next == rxTail)
+    COUNT(counters.rxDropped);
+  else
+    {
+      rxBuf[rxHead] = receivedByte;
+#ifdef WITH_LATENCY
+      rxTicks[rxHead] = timerTicks();
+#endif
+      rxHead = next;
+    }
+
+  UCSRB |= 1 << RXCIE;
+}
+
+// periodic reports at the idle rate, every 4 ms
+static void idleTask(uint16_t now)
+{
+  if (idleRate != 0 && ++idleCounter >= idleRate)
+    {
+      idleCounter = 0;
+      updateNeeded = 1;
+    }
+}
+
+static void sendReport(uchar *data, uchar len)
+{
+  COUNT(counters.reports);
+  traceAdd(TRACE_REPORT, data[0], data[len > 2 ? 2 : 1]);
+  usbSetInterrupt(data, len);
+}
+
+// awake share of the last LOAD_PERIOD ms
+static void loadTask(uint16_t now)
+{
+  uint32_t total = LOAD_PERIOD * 1000L * TIMER_TICKS_PER_US;
+
+  if (sleptTicks > total)
+    sleptTicks = total;
+  activePercent = 100 - sleptTicks * 100 / total;
+  sleptTicks = 0;
+}
+
+// nothing to do until the next interrupt: USB, the keyboard, the
+// mouse or the millisecond tick, so usbPoll() is never more than
+// 1 ms late. a byte that came in since the loop looked keeps it awake.
+// the sleep ends where the waking handler came in, it stamps that
+// itself. V-USB's handler can't, its entry is counted in cycles: a
+// USB wake-up counts until the handler returned, the transaction
+// time (about 0.1 ms per host poll) is counted as sleep.
+static void idleSleep()
+{
+  uint16_t start, end;
+
+  cli();
+  if (rxTail != rxHead)
+    {
+      sei();
+      return;
+    }
+
+  start = TCNT1;
+  timerAsleep = 1;
+  sleep_enable();
+  // the instruction after sei runs before any interrupt
+  sei();
+  sleep_cpu();
+  sleep_disable();
+
+  ATOMIC_BLOCK(ATOMIC_FORCEON)
+    {
+      end = timerAsleep ? TCNT1 : timerWoke;
+      timerAsleep = 0;
+    }
+
+  sleptTicks += (uint16_t)(end - start);
+}
+
+// Process bytes coming from the keyboard.
+static void usartReceive(uint16_t now)
+{
+  uchar receivedByte;
+#ifdef WITH_LATENCY
+  uint16_t ticks;
+#endif
+
+  while (rxTail != rxHead)
+    {
+      receivedByte = rxBuf[rxTail];
+#ifdef WITH_LATENCY
+      ticks = rxTicks[rxTail];
+#endif
+      rxTail = (rxTail + 1) & (RX_SIZE - 1);
+      traceAdd(TRACE_RX, receivedByte, 0);
+
+#ifdef WITH_LATENCY
+      if (translateByte(receivedByte, now))
+        latencyKey(ticks);
+#else
+      translateByte(receivedByte, now);
+#endif
+    }
+
+  translatePoll(now);
 }
 
 
 int main() 
 {
-  uint8_t updateNeeded = 0;
+  uint16_t now;
+  uint8_t step;
   uchar i;
 
-  uchar idleCounter = 0;
+  countersInit();
 
   // wait for keyboard to initialize and send the status report
   _delay_ms(1000);
@@ -276,23 +478,39 @@ int main()
   // enable 1 sec watchdog timer:
   wdt_enable(WDTO_1S);
 
-  // Port B as output:
+  // Port B as output, but the mouse line:
   DDRB = 0xFF;
 
   usartInit();
+  timerInit();
+#ifdef WITH_MOUSE
+  sunmouseInit();
+#endif
+  remapInit();
+  keymapInit();
   _delay_ms(100);
   usbInit();
 
-  /* timer 0 prescaler: 1024 */
-  TCCR0 = 5;      
+  // periodic work, ms
+#ifdef WITH_TURBO
+  schedAdd(1, turboPoll);
+#endif
+#ifdef WITH_CONSUMER
+  schedAdd(1, consumerPoll);
+#endif
+#ifdef WITH_MOUSE
+  schedAdd(1, mousePoll);
+  schedAdd(1, sunmousePoll);
+#endif
+  schedAdd(4, idleTask);
+  schedAdd(LED_TICK, ledTask);
+  schedAdd(LOAD_PERIOD, loadTask);
+
+  set_sleep_mode(SLEEP_MODE_IDLE);
 
   // force re-enumeration:
   usbDeviceDisconnect();
 
-  // clean the report buffer:
-  for(i = 0; i < sizeof report; i++)
-    report[i] = 0;
-
   for(i = 0; i < 250; i++) {
     wdt_reset();
     _delay_ms(2);
@@ -300,49 +518,69 @@ int main()
 
   usbDeviceConnect();
 
-  blinkB2();
+  ledStart(LED_ACTIVITY, ledFlash);
 
   // enable interrupts:
   sei();
 
+  // ask for the layout, the reply picks the keymap:
+  uart_putchar(SKBDCMD_LAYOUT);
+
   while(1) {
     wdt_reset();
     usbPoll();
+    latencyPoll();
+    remapPoll();
+    keymapPoll();
+    now = timerNow();
+    usartReceive(now);
+    schedRun(now);
+
+#ifdef WITH_MOUSE
+    // the mouse has its own endpoint, one report per host poll
+    if (usbInterruptIsReady3() && mouseReport(mouseOut))
+      {
+        usbSetInterrupt3(mouseOut, sizeof mouseOut);
+        COUNT(counters.reports);
+      }
+#endif
 
-    // do I really need it?
-    updateNeeded = newUsartByte;
-
-    // check timer if we need periodic reports
-    if (TIFR & (1 << TOV0))
+    // the report is still on its way, wake up when the host took it.
+    // a report due meanwhile waits, counted once per wait.
+    if (!usbInterruptIsReady())
       {
-        TIFR = (1 << TOV0); // reset flag
-        if (idleRate != 0)
-          { // do we need periodic reports?
-            if(idleCounter > 4){ // yes, but not yet
-              idleCounter -= 5; // 22ms in units of 4ms
-            } 
-            else 
-              { // yes, it is time now
-                updateNeeded = 1;
-                idleCounter = idleRate;
-              }
+        if (updateNeeded && !heldBack)
+          {
+            COUNT(counters.heldBack);
+            heldBack = 1;
           }
+        idleSleep();
+        continue;
       }
 
-    if (updateNeeded && usbInterruptIsReady())
+    step = translateStep(now);
+    if (step)
+      updateNeeded = 1;
+
+    if (updateNeeded)
       {
         updateNeeded = 0;
-        newUsartByte = 0;
-        usbSetInterrupt(&report, sizeof report);
-
-        // clean the report if macro replayed:
-        if(macroReplay)
-          {
-            macroReplay = 0;
-            report[0] = 0;
-            report[2] = 0;
-          }
+        heldBack = 0;
+        idleCounter = 0;
+        translateReport(reportOut);
+        sendReport(reportOut, sizeof reportOut);
+        // idle resends and macro steps carry no key stamp
+        if (step & TRANSLATE_KEY)
+          latencySent();
+        ledStart(LED_ACTIVITY, ledFlash);
       }
+#ifdef WITH_CONSUMER
+    // consumer reports only go out when no key is waiting
+    else if (consumerReport(consumerOut))
+      sendReport(consumerOut, sizeof consumerOut);
+#endif
+    else
+      idleSleep();
   }
 
   return 0;
@@ -0,0 +1,217 @@
+/*
+ * Mouse keys and the Sun mouse, sent on their own interface and
+ * endpoint 3.
+ *
+ * Held direction keys move the pointer with a speed taken from a
+ * fixed-point curve by the time they are held, evaluated on the
+ * millisecond tick. Movement is added up in 8.8 fixed point until the
+ * host reads the next report, so there is never more than one report
+ * per poll interval, however fast the tick is. Serial mouse motion is
+ * added to the same sums, what doesn't fit one report goes in the next.
+ */
+#include <avr/pgmspace.h>
+
+#include "sun_defs.h"
+#include "keymap.h"
+#include "timer.h"
+#include "mouse.h"
+
+PROGMEM const char mouseReportDescriptor[MOUSE_REPORT_DESCRIPTOR_LENGTH] = {
+    0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
+    0x09, 0x02,                    // USAGE (Mouse)
+    0xa1, 0x01,                    // COLLECTION (Application)
+    0x09, 0x01,                    //   USAGE (Pointer)
+    0xa1, 0x00,                    //   COLLECTION (Physical)
+    0x05, 0x09,                    //     USAGE_PAGE (Button)
+    0x19, 0x01,                    //     USAGE_MINIMUM (Button 1)
+    0x29, 0x03,                    //     USAGE_MAXIMUM (Button 3)
+    0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //     LOGICAL_MAXIMUM (1)
+    0x95, 0x03,                    //     REPORT_COUNT (3)
+    0x75, 0x01,                    //     REPORT_SIZE (1)
+    0x81, 0x02,                    //     INPUT (Data,Var,Abs)
+    0x95, 0x01,                    //     REPORT_COUNT (1)
+    0x75, 0x05,                    //     REPORT_SIZE (5)
+    0x81, 0x03,                    //     INPUT (Cnst,Var,Abs)
+    0x05, 0x01,                    //     USAGE_PAGE (Generic Desktop)
+    0x09, 0x30,                    //     USAGE (X)
+    0x09, 0x31,                    //     USAGE (Y)
+    0x09, 0x38,                    //     USAGE (Wheel)
+    0x15, 0x81,                    //     LOGICAL_MINIMUM (-127)
+    0x25, 0x7f,                    //     LOGICAL_MAXIMUM (127)
+    0x75, 0x08,                    //     REPORT_SIZE (8)
+    0x95, 0x03,                    //     REPORT_COUNT (3)
+    0x81, 0x06,                    //     INPUT (Data,Var,Rel)
+    0xc0,                          //   END_COLLECTION
+    0xc0                           // END_COLLECTION
+};
+
+// speed in pixels per ms, 8.8 fixed point, by the time a direction
+// is held in 128 ms steps. 0.2 px/ms is 2 pixels per 10 ms report.
+static const uint16_t mouseCurve[] PROGMEM = {
+  51,       // 0.2
+  77,       // 0.3
+  102,      // 0.4
+  154,      // 0.6
+  205,      // 0.8
+  307,      // 1.2
+  410,      // 1.6
+  512,      // 2.0 from 0.9 s on
+};
+
+#define CURVE_STEPS  (sizeof mouseCurve / sizeof *mouseCurve)
+
+// movement not reported yet, a report carries +-127 pixels
+#define REPORT_MAX  127
+#define MOUSE_MAX   (1024L * 256)
+
+// keys held per direction (up, down, left, right) and button
+static uint8_t held[4];
+static uint8_t buttonHeld[3];
+
+static int32_t moveX = 0;
+static int32_t moveY = 0;
+static int8_t wheel = 0;
+static uint8_t buttonsSerial = 0;
+static uint8_t buttonsSent = 0;
+
+static uint16_t since;
+static uint16_t last;
+
+static uint8_t buttons()
+{
+  uint8_t i, b = buttonsSerial;
+
+  for (i = 0; i < 3; i++)
+    if (buttonHeld[i])
+      b |= 1 << i;
+
+  return b;
+}
+
+static uint8_t moving()
+{
+  return held[0] | held[1] | held[2] | held[3];
+}
+
+static int32_t clamp(int32_t v)
+{
+  if (v > MOUSE_MAX)
+    return MOUSE_MAX;
+  if (v < -MOUSE_MAX)
+    return -MOUSE_MAX;
+  return v;
+}
+
+void mouseKey(uint8_t code, uint8_t keyUp)
+{
+  uint8_t i;
+  int8_t step = keyUp ? -1 : 1;
+
+  if (code & MOUSE_WHEEL)
+    {
+      if (!keyUp)
+        wheel += (code & 1) ? -1 : 1;
+      return;
+    }
+
+  if (code & MOUSE_BUTTON)
+    {
+      for (i = 0; i < 3; i++)
+        if ((code & (1 << i)) && (!keyUp || buttonHeld[i]))
+          buttonHeld[i] += step;
+      return;
+    }
+
+  // a new movement starts slow and moves one pixel right away
+  if (!keyUp && !moving())
+    {
+      since = timerNow();
+      moveX = clamp(moveX + ((code & MOUSE_RIGHT) ? 256 : (code & MOUSE_LEFT) ? -256 : 0));
+      moveY = clamp(moveY + ((code & MOUSE_DOWN) ? 256 : (code & MOUSE_UP) ? -256 : 0));
+    }
+
+  // a release of a key that isn't counted, e.g. after a turbo
+  // release, must not wrap the count
+  for (i = 0; i < 4; i++)
+    if ((code & (1 << i)) && (!keyUp || held[i]))
+      held[i] += step;
+}
+
+void mousePoll(uint16_t now)
+{
+  uint16_t ms = now - last;
+  uint16_t t = (uint16_t)(now - since) >> 7;
+  int16_t d;
+
+  last = now;
+
+  if (!moving())
+    return;
+
+  if (t >= CURVE_STEPS)
+    t = CURVE_STEPS - 1;
+
+  // at most 2 px/ms, 50 ms of it still fit
+  if (ms > 50)
+    ms = 50;
+  d = pgm_read_word(&mouseCurve[t]) * ms;
+
+  if (held[3] && !held[2])
+    moveX = clamp(moveX + d);
+  else if (held[2] && !held[3])
+    moveX = clamp(moveX - d);
+
+  if (held[1] && !held[0])
+    moveY = clamp(moveY + d);
+  else if (held[0] && !held[1])
+    moveY = clamp(moveY - d);
+}
+
+// motion from the serial mouse, in pixels, y down
+void mouseMove(int16_t dx, int16_t dy)
+{
+  moveX = clamp(moveX + dx * 256L);
+  moveY = clamp(moveY + dy * 256L);
+}
+
+// buttons held on the serial mouse, report bits
+void mouseButtons(uint8_t b)
+{
+  buttonsSerial = b;
+}
+
+static int8_t reportPixels(int32_t v)
+{
+  v /= 256;
+  if (v > REPORT_MAX)
+    return REPORT_MAX;
+  if (v < -REPORT_MAX)
+    return -REPORT_MAX;
+  return v;
+}
+
+// fill the mouse report with everything since the last one,
+// returns 0 if there's nothing to send
+uint8_t mouseReport(uint8_t *report)
+{
+  int8_t x = reportPixels(moveX);
+  int8_t y = reportPixels(moveY);
+  uint8_t b = buttons();
+
+  if (x == 0 && y == 0 && wheel == 0 && b == buttonsSent)
+    return 0;
+
+  // the fraction and what didn't fit stay for the next report
+  moveX -= x * 256L;
+  moveY -= y * 256L;
+
+  report[0] = b;
+  report[1] = x;
+  report[2] = y;
+  report[3] = wheel;
+
+  wheel = 0;
+  buttonsSent = b;
+  return 1;
+}
@@ -0,0 +1,24 @@
+#ifndef MOUSE_HEADER_H
+# define MOUSE_HEADER_H
+
+#include <stdint.h>
+
+#define MOUSE_REPORT_DESCRIPTOR_LENGTH  52
+
+// [buttons][x][y][wheel], relative
+#define MOUSE_REPORT_SIZE  4
+
+#ifdef WITH_MOUSE
+extern const char mouseReportDescriptor[MOUSE_REPORT_DESCRIPTOR_LENGTH];
+
+void mouseKey(uint8_t code, uint8_t keyUp);
+void mousePoll(uint16_t now);
+void mouseMove(int16_t dx, int16_t dy);
+void mouseButtons(uint8_t b);
+uint8_t mouseReport(uint8_t *report);
+#else
+// no mouse interface, mouse keys do nothing
+# define mouseKey(code, keyUp)
+#endif
+
+#endif
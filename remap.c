@@ -0,0 +1,183 @@
+/*
+ * Sparse scancode -> usage overrides.
+ *
+ * The list lives in EEPROM (count byte followed by the pairs) and is
+ * copied to RAM at boot. A bitmap over all scancodes keeps the cost
+ * for keys without an override at one bit test, the others are found
+ * by binary search. Changes are written back to EEPROM from the main
+ * loop, one byte per pass so nothing ever waits for the EEPROM.
+ */
+#include <avr/eeprom.h>
+
+#include "remap.h"
+
+static uint8_t eeRemap[1 + 2 * REMAP_MAX] EEMEM;
+
+uint8_t remapTable[REMAP_MAX][2];
+uint8_t remapCount = 0;
+
+static uint8_t remapBits[128 / 8];
+
+// EEPROM write back: position of the next byte, 0xff when clean
+static uint8_t writePos = 0xff;
+
+static void setBit(uint8_t sc)
+{
+  remapBits[sc >> 3] |= 1 << (sc & 7);
+}
+
+static void clearBit(uint8_t sc)
+{
+  remapBits[sc >> 3] &= ~(1 << (sc & 7));
+}
+
+void remapInit()
+{
+  uint8_t i, count, sc, usage;
+
+  remapCount = 0;
+  for (i = 0; i < sizeof remapBits; i++)
+    remapBits[i] = 0;
+
+  // blank EEPROM reads 0xff:
+  count = eeprom_read_byte(&eeRemap[0]);
+  if (count > REMAP_MAX)
+    return;
+
+  // the pairs were written sorted, find() relies on it. anything
+  // else is a damaged EEPROM: the table is dropped, and with it
+  // the copy in EEPROM.
+  for (i = 0; i < count; i++)
+    {
+      sc = eeprom_read_byte(&eeRemap[1 + 2 * i]);
+      usage = eeprom_read_byte(&eeRemap[2 + 2 * i]);
+
+      if (sc > 0x7f || usage == 0 || (i > 0 && sc <= remapTable[i - 1][0]))
+        {
+          remapClear();
+          return;
+        }
+
+      remapTable[i][0] = sc;
+      remapTable[i][1] = usage;
+      setBit(sc);
+    }
+
+  remapCount = count;
+}
+
+// position of sc in the table, or where it would be inserted
+static uint8_t find(uint8_t sc)
+{
+  uint8_t lo = 0, hi = remapCount, mid;
+
+  while (lo < hi)
+    {
+      mid = (lo + hi) >> 1;
+      if (remapTable[mid][0] < sc)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+// return the override for sc, 0 if there's none
+uint8_t remapLookup(uint8_t sc)
+{
+  if (!(remapBits[sc >> 3] & (1 << (sc & 7))))
+    return 0;
+
+  return remapTable[find(sc)][1];
+}
+
+// add, change or (usage 0) remove an override.
+// return 0 if the table is full.
+uint8_t remapSet(uint8_t sc, uint8_t usage)
+{
+  uint8_t pos, i;
+
+  sc &= 0x7f;
+  pos = find(sc);
+
+  if (pos < remapCount && remapTable[pos][0] == sc)
+    {
+      if (usage)
+        remapTable[pos][1] = usage;
+      else
+        {
+          clearBit(sc);
+          remapCount--;
+          for (i = pos; i < remapCount; i++)
+            {
+              remapTable[i][0] = remapTable[i + 1][0];
+              remapTable[i][1] = remapTable[i + 1][1];
+            }
+        }
+    }
+  else if (usage)
+    {
+      if (remapCount == REMAP_MAX)
+        return 0;
+
+      for (i = remapCount; i > pos; i--)
+        {
+          remapTable[i][0] = remapTable[i - 1][0];
+          remapTable[i][1] = remapTable[i - 1][1];
+        }
+      remapTable[pos][0] = sc;
+      remapTable[pos][1] = usage;
+      remapCount++;
+      setBit(sc);
+    }
+
+  writePos = 0;
+  return 1;
+}
+
+void remapClear()
+{
+  uint8_t i;
+
+  remapCount = 0;
+  for (i = 0; i < sizeof remapBits; i++)
+    remapBits[i] = 0;
+
+  writePos = 0;
+}
+
+// write the table back to EEPROM, one byte per call. the count is
+// zeroed first, then the pairs go and the count comes last: a reset
+// in between leaves an empty table, never a count over a mix of old
+// and new pairs.
+void remapPoll()
+{
+  uint8_t value, pos;
+
+  if (writePos == 0xff || !eeprom_is_ready())
+    return;
+
+  if (writePos == 0)
+    {
+      value = 0;
+      pos = 0;
+    }
+  else if (writePos <= 2 * remapCount)
+    {
+      value = remapTable[(writePos - 1) >> 1][(writePos - 1) & 1];
+      pos = writePos;
+    }
+  else
+    {
+      value = remapCount;
+      pos = 0;
+    }
+
+  eeprom_update_byte(&eeRemap[pos], value);
+
+  if (writePos > 2 * remapCount)
+    writePos = 0xff;
+  else
+    writePos++;
+}
@@ -0,0 +1,26 @@
+#ifndef REMAP_HEADER_H
+# define REMAP_HEADER_H
+
+#include <stdint.h>
+
+#define REMAP_MAX  16
+
+// runtime overrides of the layer 0 table: {scancode, usage} pairs
+// sorted by scancode, remapCount of them are in use.
+extern uint8_t remapTable[REMAP_MAX][2];
+extern uint8_t remapCount;
+
+#ifdef WITH_REMAP
+void remapInit(void);
+uint8_t remapLookup(uint8_t sc);
+uint8_t remapSet(uint8_t sc, uint8_t usage);
+void remapClear(void);
+void remapPoll(void);
+#else
+// layer 0 as the tables have it, the vendor requests are left out
+# define remapInit()
+# define remapLookup(sc)  0
+# define remapPoll()
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Periodic tasks on the millisecond tick.
+ *
+ * The tasks are added once at start up and run from the main loop,
+ * each when its period is over. A task that's late runs once and is
+ * due a period later, missed runs are not made up: the tasks look at
+ * the time themselves.
+ */
+#include "timer.h"
+#include "sched.h"
+
+typedef struct
+{
+  uint16_t due;      // ms
+  uint8_t period;    // ms
+  TaskRun run;
+} Task;
+
+static Task tasks[SCHED_TASKS];
+static uint8_t taskCount = 0;
+
+uint16_t schedWorst[SCHED_TASKS];
+
+void schedAdd(uint8_t period, TaskRun run)
+{
+  if (taskCount == SCHED_TASKS)
+    return;
+
+  tasks[taskCount].due = timerNow() + period;
+  tasks[taskCount].period = period;
+  tasks[taskCount].run = run;
+  taskCount++;
+}
+
+void schedRun(uint16_t now)
+{
+  uint8_t i;
+  uint16_t start, t;
+  Task *task;
+
+  for (i = 0; i < taskCount; i++)
+    {
+      task = &tasks[i];
+      if ((int16_t)(now - task -> due) < 0)
+        continue;
+
+      start = timerTicks();
+      task -> run(now);
+      t = timerTicks() - start;
+      if (t > schedWorst[i])
+        schedWorst[i] = t;
+
+      task -> due += task -> period;
+      if ((int16_t)(now - task -> due) >= 0)
+        task -> due = now + task -> period;
+    }
+}
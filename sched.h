@@ -0,0 +1,16 @@
+#ifndef SCHED_HEADER_H
+# define SCHED_HEADER_H
+
+#include <stdint.h>
+
+#define SCHED_TASKS  7
+
+typedef void (*TaskRun)(uint16_t now);
+
+// longest run of every task in the order added, timer 1 ticks
+extern uint16_t schedWorst[SCHED_TASKS];
+
+void schedAdd(uint8_t period, TaskRun run);
+void schedRun(uint16_t now);
+
+#endif
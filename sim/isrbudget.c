@@ -0,0 +1,367 @@
+/*
+ * isrbudget - run the firmware in simavr and check its interrupt
+ * cycle budgets.
+ *
+ *   isrbudget [-c CYCLES] [-r CYCLES] [-i ADDR]... [-p ADDR [-w CYCLES]]
+ *             [-f ADDR] main.elf
+ *
+ * The session starts at the first sei, the end of the boot delays:
+ * the layout reply, key presses and releases, a combo, a leader
+ * sequence with a macro, and Sun mouse packets on the soft UART pin.
+ * The USB lines are kept idle, V-USB's own interrupt never runs, it
+ * is the one the budgets protect. The host's IN tokens are faked
+ * instead: every USB_CFG_INTR_POLL_INTERVAL ms the harness takes the
+ * report waiting in each usbTxStatus_t given with -i (its data
+ * address, from avr-nm) and marks it sent, like the interrupt does.
+ * Without -i the first report is never taken and the main loop waits
+ * for the host from then on, only the interrupts are exercised.
+ *
+ * Measured, in CPU cycles:
+ *  - the longest stretch with interrupts off after the first sei,
+ *    this is how long the USB interrupt could be held up. V-USB
+ *    allows 25 cycles at 12 MHz, -c, 33 by default for 16 MHz.
+ *  - every interrupt handler from its vector to reti, nested ones
+ *    included, and how long it ran before enabling interrupts.
+ *    -r is the limit for the longest run, 1600 (100 us) by default.
+ *  - the longest gap between two calls of usbPoll(), its flash
+ *    address given with -p. -w is the limit, 800000 (50 ms) by
+ *    default: V-USB wants the call before a SETUP times out.
+ *  - the share of the session the CPU was awake, not sleeping.
+ *  - with -f, the calls of the function at that flash address (or of
+ *    a handler, its vector jumps there) from entry to ret or reti,
+ *    without the interrupts nested in them.
+ *
+ * Exits 1 if a budget is exceeded. Needs simavr, see the Makefile.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_ioport.h>
+
+#define F_CPU       16000000
+#define MS          (F_CPU / 1000)
+#define VECTORS     19        // ATmega8, one word each
+#define BIT_CYCLES  (F_CPU / 1200)
+#define POLL_MS     10        // USB_CFG_INTR_POLL_INTERVAL
+#define ENDPOINTS   2         // interrupt IN endpoints 1 and 3
+#define PID_NAK     0x5a      // USBPID_NAK, nothing to send
+#define SPL         0x5d      // stack pointer, data addresses
+#define SPH         0x5e
+
+static const char *vectorNames[VECTORS] = {
+  "RESET", "INT0", "INT1", "TIMER2_COMP", "TIMER2_OVF", "TIMER1_CAPT",
+  "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF", "TIMER0_OVF", "SPI_STC",
+  "USART_RXC", "USART_UDRE", "USART_TXC", "ADC", "EE_RDY", "ANA_COMP",
+  "TWI", "SPM_RDY"
+};
+
+// scripted session, ms after the first sei and the byte from the keyboard
+typedef struct
+{
+  unsigned ms;
+  unsigned char byte;
+} KeyByte;
+
+static const KeyByte session[] = {
+  {10, 0xfe}, {18, 0x21},                     // layout reply, US type 5
+  {100, 0x4d}, {160, 0xcd},                   // a
+  {200, 0x63}, {210, 0x4d}, {250, 0xcd}, {260, 0xe3},      // shift a
+  {300, 0x01}, {310, 0x03}, {400, 0x81}, {410, 0x83},      // Stop + Again
+  {500, 0x76}, {550, 0xf6}, {600, 0x4e}, {630, 0xce},      // Help, s
+  {1000, 0x4d}, {1008, 0x4e}, {1016, 0x4f}, {1024, 0xcd},  // back to back
+  {1032, 0xce}, {1040, 0xcf}, {1048, 0x7f},
+};
+
+// Mouse Systems packets: buttons, dx, dy, dx, dy
+static const unsigned char mousePackets[][5] = {
+  {0x87, 5, 3, 4, 2},
+  {0x83, 0x80, 0x7f, 0, 0},
+  {0x87, 0xff, 0xfe, 0xff, 0xfe},
+};
+
+#define MOUSE_START  100    // ms after the first sei
+#define MOUSE_GAP    60     // ms between packets
+#define RUN_MS       1400   // ms after the first sei
+
+static avr_t *avr;
+static avr_irq_t *mousePin;
+
+// the mouse line without inverter: idle low, start bit high
+static void mouseLevel(avr_cycle_count_t boot, avr_cycle_count_t now)
+{
+  static int level = -1;
+  avr_cycle_count_t start = boot + (avr_cycle_count_t)MOUSE_START * MS;
+  avr_cycle_count_t t;
+  unsigned p, byte, bit;
+  int mark = 1;
+
+  if (now >= start)
+    {
+      t = now - start;
+      p = t / ((avr_cycle_count_t)MOUSE_GAP * MS);
+      t -= (avr_cycle_count_t)p * MOUSE_GAP * MS;
+      byte = t / (10 * BIT_CYCLES);
+      bit = (t % (10 * BIT_CYCLES)) / BIT_CYCLES;
+
+      if (p < sizeof mousePackets / sizeof *mousePackets && byte < 5)
+        mark = bit == 0 ? 0 : bit == 9 ? 1 : (mousePackets[p][byte] >> (bit - 1)) & 1;
+    }
+
+  if (level != !mark)
+    {
+      level = !mark;
+      avr_raise_irq(mousePin, level);
+    }
+}
+
+// the host's IN token: a report waiting on the endpoint is taken
+static unsigned takeReport(unsigned addr)
+{
+  if (avr -> data[addr] & 0x10)
+    return 0;
+  avr -> data[addr] = PID_NAK;
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  elf_firmware_t f;
+  avr_irq_t *uartIn;
+  avr_cycle_count_t boot = 0, end = 0, poll = 0;
+  avr_cycle_count_t cliStart = 0, cliMax = 0, cliAt = 0;
+  avr_cycle_count_t before, asleep = 0, pollLast = 0, pollMax = 0;
+  avr_cycle_count_t fnStart = 0, fnNested = 0, fnTotal = 0, fnMin = ~0ULL, fnMax = 0;
+  avr_cycle_count_t entry[8], isrMax[VECTORS] = {0}, isrOff[VECTORS] = {0};
+  unsigned long isrCount[VECTORS] = {0};
+  unsigned char nest[8], offDone[8];
+  unsigned long taken[ENDPOINTS] = {0};
+  unsigned txStatus[ENDPOINTS];
+  unsigned long pollCount = 0, pollBudget = 800000, fnCount = 0;
+  unsigned fnAddr = 0, fnSp = 0, fnDepth = 0, depthBefore, sp;
+  unsigned cliBudget = 33, runBudget = 1600, endpoints = 0, pollAddr = 0;
+  unsigned depth = 0, next = 0, v, op;
+  int c, state, wasSleeping, wasOn = 0, fail = 0, fnIn = 0;
+
+  while ((c = getopt(argc, argv, "c:r:i:p:w:f:")) != -1)
+    {
+      if (c == 'c')
+        cliBudget = strtoul(optarg, NULL, 0);
+      else if (c == 'r')
+        runBudget = strtoul(optarg, NULL, 0);
+      else if (c == 'i' && endpoints < ENDPOINTS)
+        // avr-nm gives data addresses with the 0x800000 offset
+        txStatus[endpoints++] = strtoul(optarg, NULL, 0) & 0xffff;
+      else if (c == 'p')
+        pollAddr = strtoul(optarg, NULL, 0);
+      else if (c == 'w')
+        pollBudget = strtoul(optarg, NULL, 0);
+      else if (c == 'f')
+        fnAddr = strtoul(optarg, NULL, 0);
+      else
+        optind = argc;
+    }
+
+  if (optind != argc - 1)
+    {
+      fprintf(stderr, "usage: %s [-c CYCLES] [-r CYCLES] [-i ADDR]... "
+              "[-p ADDR [-w CYCLES]] [-f ADDR] main.elf\n", argv[0]);
+      return 2;
+    }
+
+  memset(&f, 0, sizeof f);
+  if (elf_read_firmware(argv[optind], &f))
+    {
+      fprintf(stderr, "%s: can't read\n", argv[optind]);
+      return 2;
+    }
+  strcpy(f.mmcu, "atmega8");
+  f.frequency = F_CPU;
+
+  avr = avr_make_mcu_by_name(f.mmcu);
+  avr_init(avr);
+  avr_load_firmware(avr, &f);
+
+  uartIn = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+  mousePin = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 0);
+
+  // USB idle for a low speed device: D- (PD4) high, D+ (PD2) low
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 4), 1);
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 2), 0);
+
+  while (!boot || avr -> cycle < end)
+    {
+      if (boot)
+        {
+          if (next < sizeof session / sizeof *session
+              && avr -> cycle >= boot + (avr_cycle_count_t)session[next].ms * MS)
+            avr_raise_irq(uartIn, session[next++].byte);
+          mouseLevel(boot, avr -> cycle);
+
+          if (avr -> cycle >= poll)
+            {
+              for (v = 0; v < endpoints; v++)
+                taken[v] += takeReport(txStatus[v]);
+              poll += (avr_cycle_count_t)POLL_MS * MS;
+            }
+        }
+
+      op = avr -> flash[avr -> pc] | avr -> flash[avr -> pc + 1] << 8;
+      wasSleeping = avr -> state == cpu_Sleeping;
+      before = avr -> cycle;
+      state = avr_run(avr);
+      if (state == cpu_Done || state == cpu_Crashed)
+        {
+          fprintf(stderr, "firmware stopped at %#x\n", avr -> pc);
+          return 2;
+        }
+
+      if (boot)
+        {
+          if (wasSleeping)
+            asleep += avr -> cycle - before;
+
+          if (pollAddr && avr -> pc == pollAddr)
+            {
+              if (avr -> cycle - pollLast > pollMax)
+                pollMax = avr -> cycle - pollLast;
+              pollLast = avr -> cycle;
+              pollCount++;
+            }
+        }
+
+      depthBefore = depth;
+
+      // reti: the handler on top is done
+      if (op == 0x9518 && depth)
+        {
+          depth--;
+          v = nest[depth];
+          if (avr -> cycle - entry[depth] > isrMax[v])
+            isrMax[v] = avr -> cycle - entry[depth];
+        }
+
+      // a vector was taken
+      if (avr -> pc > 0 && avr -> pc < VECTORS * 2 && !(avr -> pc & 1)
+          && depth < sizeof nest)
+        {
+          v = avr -> pc / 2;
+          nest[depth] = v;
+          offDone[depth] = 0;
+          entry[depth++] = avr -> cycle;
+          isrCount[v]++;
+        }
+
+      // the profiled function: interrupts nested in it don't count,
+      // it returns above its entry stack pointer. an interrupt taken
+      // right after the ret has pushed its return address already.
+      if (fnIn)
+        {
+          if (depthBefore > fnDepth)
+            fnNested += avr -> cycle - before;
+
+          sp = avr -> data[SPL] | avr -> data[SPH] << 8;
+          if (depth > depthBefore)
+            sp += 2;
+          if ((op == 0x9508 || op == 0x9518) && sp > fnSp)
+            {
+              fnIn = 0;
+              fnTotal += avr -> cycle - fnStart - fnNested;
+              if (avr -> cycle - fnStart - fnNested > fnMax)
+                fnMax = avr -> cycle - fnStart - fnNested;
+              if (avr -> cycle - fnStart - fnNested < fnMin)
+                fnMin = avr -> cycle - fnStart - fnNested;
+              fnCount++;
+            }
+        }
+      else if (fnAddr && boot && avr -> pc == fnAddr)
+        {
+          fnIn = 1;
+          fnStart = avr -> cycle;
+          fnNested = 0;
+          fnSp = avr -> data[SPL] | avr -> data[SPH] << 8;
+          fnDepth = depth;
+        }
+
+      // cycles until the handler on top enables interrupts
+      if (depth && !offDone[depth - 1] && avr -> sreg[S_I])
+        {
+          offDone[depth - 1] = 1;
+          v = nest[depth - 1];
+          if (avr -> cycle - entry[depth - 1] > isrOff[v])
+            isrOff[v] = avr -> cycle - entry[depth - 1];
+        }
+
+      // interrupts off, from the first sei on
+      if (avr -> sreg[S_I])
+        {
+          if (!boot)
+            {
+              boot = poll = pollLast = avr -> cycle;
+              end = boot + (avr_cycle_count_t)RUN_MS * MS;
+            }
+          if (wasOn && cliStart && avr -> cycle - cliStart > cliMax)
+            {
+              cliMax = avr -> cycle - cliStart;
+              cliAt = avr -> pc;
+            }
+          cliStart = 0;
+          wasOn = 1;
+        }
+      else if (wasOn && !cliStart)
+        cliStart = avr -> cycle;
+    }
+
+  printf("%-14s %8s %10s %10s\n", "vector", "count", "run", "int off");
+  for (v = 1; v < VECTORS; v++)
+    {
+      if (!isrCount[v])
+        continue;
+      printf("%-14s %8lu %10llu %10llu\n", vectorNames[v], isrCount[v],
+             (unsigned long long)isrMax[v], (unsigned long long)isrOff[v]);
+      if (isrMax[v] > runBudget)
+        {
+          printf("  run over the budget of %u cycles\n", runBudget);
+          fail = 1;
+        }
+    }
+
+  printf("longest interrupts off: %llu cycles, ending at %#llx\n",
+         (unsigned long long)cliMax, (unsigned long long)cliAt);
+  if (cliMax > cliBudget)
+    {
+      printf("  over the budget of %u cycles\n", cliBudget);
+      fail = 1;
+    }
+
+  printf("awake %.1f%% of the %u ms after the first sei\n",
+         100.0 * (end - boot - asleep) / (end - boot), RUN_MS);
+
+  if (pollAddr)
+    {
+      printf("usbPoll: %lu calls, longest gap %llu cycles (%llu us)\n", pollCount,
+             (unsigned long long)pollMax, (unsigned long long)pollMax / (MS / 1000));
+      if (pollMax > pollBudget)
+        {
+          printf("  over the budget of %lu cycles\n", pollBudget);
+          fail = 1;
+        }
+    }
+
+  if (fnCount)
+    printf("%#x: %lu calls, cycles min %llu, average %llu, max %llu\n", fnAddr, fnCount,
+           (unsigned long long)fnMin, (unsigned long long)(fnTotal / fnCount),
+           (unsigned long long)fnMax);
+
+  for (v = 0; v < endpoints; v++)
+    printf("reports taken from %#x: %lu\n", txStatus[v] | 0x800000, taken[v]);
+
+  if (next < sizeof session / sizeof *session)
+    printf("session not finished\n");
+
+  return fail;
+}
@@ -0,0 +1,46 @@
+/*
+ * Stack high-water mark.
+ *
+ * Before the start up code runs, the RAM between the end of the static
+ * data and the top of the stack is painted with a known byte. The scan
+ * counts how much of it the stack never reached.
+ */
+#include "sun_defs.h"
+#include "stack.h"
+
+#define STACK_PAINT  0xc5
+
+extern uint8_t _end;
+extern uint8_t __stack;
+
+StackStats stackStats;
+
+// runs before the stack pointer is set up: no C, no calls
+void stackPaint(void) __attribute__((naked, used, section(".init1")));
+
+void stackPaint(void)
+{
+  asm volatile("    ldi r30, lo8(_end)\n\t"
+               "    ldi r31, hi8(_end)\n\t"
+               "    ldi r24, %0\n\t"
+               "    ldi r25, hi8(__stack)\n\t"
+               "    rjmp 2f\n\t"
+               "1:  st Z+, r24\n\t"
+               "2:  cpi r30, lo8(__stack)\n\t"
+               "    cpc r31, r25\n\t"
+               "    brlo 1b\n\t"
+               "    breq 1b\n\t"
+               :: "M" (STACK_PAINT));
+}
+
+// a few thousand cycles with interrupts on, fine from a vendor request
+void stackScan()
+{
+  const uint8_t *p = &_end;
+
+  while (p <= &__stack && *p == STACK_PAINT)
+    p++;
+
+  stackStats.size = &__stack - &_end + 1;
+  stackStats.unused = p - &_end;
+}
@@ -0,0 +1,17 @@
+#ifndef STACK_HEADER_H
+# define STACK_HEADER_H
+
+#include <stdint.h>
+
+// read by VREQ_STACK_GET, bytes
+typedef struct
+{
+  uint16_t size;     // from the end of the static data to RAMEND
+  uint16_t unused;   // never touched by the stack since reset
+} StackStats;
+
+extern StackStats stackStats;
+
+void stackScan(void);
+
+#endif
@@ -1,6 +1,15 @@
+#ifndef SUN_DEFS_HEADER_H
+# define SUN_DEFS_HEADER_H
+
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/wdt.h>
+#include <avr/pgmspace.h>
+
+// older avr-libc has no pointer read, pointers are a word here
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(p)  ((void *)pgm_read_word(p))
+#endif
 
 #define F_CPU 16000000L
 
@@ -14,3 +23,103 @@
 // static uchar buildUsbReport(uchar rb);
 usbMsgLen_t usbFunctionSetup(uchar data[8]);
 usbMsgLen_t usbFunctionWrite(uint8_t * data, uchar len);
+
+
+#define USART_BAUDRATE 1200
+#define BAUD_PRESCALE (((F_CPU / (USART_BAUDRATE * 16UL))) - 1 )
+
+
+
+/* SUN keyboard commands */
+#define SKBDCMD_RESET       0x01
+#define SKBDCMD_BELLON      0x02
+#define SKBDCMD_BELLOFF     0x03
+#define SKBDCMD_CLICK       0x0a
+#define SKBDCMD_NOCLICK     0x0b
+#define SKBDCMD_SETLED      0x0e
+#define SKBDCMD_LAYOUT      0x0f
+
+
+/* USB equivalents. order of bits are different from SUN's definition. */
+#define USB_LED_NLOCK          	0x01   /* Num-locgk */
+#define USB_LED_CLOCK          	0x02   /* Caps-lock */
+#define USB_LED_SCRLCK        	0x04   /* Scroll-lock */
+#define USB_LED_CMPOSE        	0x08   /* Compose */
+
+/* report IDs, see usbHidReportDescriptor */
+#define REPORT_ID_KEYBOARD      1      /* [id][modifiers][6 keys] */
+#define REPORT_ID_CONSUMER      2      /* [id][16 bit usage] */
+
+/* vendor requests */
+#define VREQ_REMAP_SET          0x01   /* wValue: scancode, usage (0 removes) */
+#define VREQ_REMAP_CLEAR        0x02
+#define VREQ_REMAP_GET          0x03   /* returns the {scancode, usage} pairs */
+#define VREQ_PROFILE_SET        0x04   /* wValue: profile */
+#define VREQ_PROFILE_GET        0x05   /* returns the active profile */
+#define VREQ_TURBO_SET          0x06   /* wValue: scancode, 1 on / 0 off */
+#define VREQ_TURBO_RATE         0x07   /* wValue: press/release pairs per second */
+#define VREQ_TURBO_GET          0x08   /* returns configured, achieved Hz and missed edges */
+#define VREQ_SUNMOUSE_GET       0x09   /* returns longest receive interrupt, packets, errors */
+#define VREQ_SCHED_GET          0x0a   /* returns the longest run of every task, 0.5 us */
+#define VREQ_LOAD_GET           0x0b   /* returns the percent of time awake */
+#define VREQ_LATENCY_GET        0x0c   /* returns the key latency histograms */
+#define VREQ_LATENCY_CLEAR      0x0d
+#define VREQ_COUNTERS_GET       0x0e   /* returns the runtime counters */
+#define VREQ_TRACE_GET          0x0f   /* returns the trace ring, see trace.h */
+#define VREQ_STACK_GET          0x10   /* returns stack size and bytes never used */
+
+/* USB modifier bits, first byte of the keyboard report */
+#define USB_MOD_LCTRL           0x01
+#define USB_MOD_LSHIFT          0x02
+#define USB_MOD_LALT            0x04
+#define USB_MOD_LGUI            0x08
+#define USB_MOD_RCTRL           0x10
+#define USB_MOD_RSHIFT          0x20
+#define USB_MOD_RALT            0x40
+#define USB_MOD_RGUI            0x80
+
+/* USB usages the firmware generates itself */
+#define USB_KEY_ENTER           0x28
+#define USB_KEY_ESCAPE          0x29
+#define USB_KEY_TAB             0x2b
+#define USB_KEY_SPACE           0x2c
+#define USB_KEY_APPLICATION     0x65
+
+/* Layout byte sent after SKBD_LYOUT */
+#define SKBD_LAYOUT_US4         0x00   /* 0x00 - 0x20 are type 4 */
+#define SKBD_LAYOUT_JAPAN4      0x20
+#define SKBD_LAYOUT_US5         0x21
+#define SKBD_LAYOUT_US5_UNIX    0x22
+#define SKBD_LAYOUT_GERMANY5    0x25
+#define SKBD_LAYOUT_JAPAN5      0x31
+
+/* Special state characters */
+#define SKBD_RESET          0xff
+#define SKBD_LYOUT          0xfe
+#define SKBD_ALLUP          0x7f
+
+/* Special Keys */
+#define SKBD_HELP	 0x76
+#define SKBD_STOP	 0x01
+#define SKBD_AGAIN	 0x03
+#define SKBD_PROPS	 0x19
+#define SKBD_UNDO	 0x1a
+#define SKBD_FRONT	 0x31
+#define SKBD_COPY	 0x33
+#define SKBD_OPEN	 0x48
+#define SKBD_PASTE	 0x49
+#define SKBD_FIND	 0x5f
+#define SKBD_CUT	 0x61
+#define SKBD_POWER	 0x30
+
+
+#define KEY_COMPOSE  0x43
+
+enum HID_ConsumerCodes
+{
+    CKEY_Mute       = 0xE2,
+    CKEY_VolumeUp   = 0xE9,
+    CKEY_VolumeDown = 0xEA,
+};
+
+#endif
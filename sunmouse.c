@@ -0,0 +1,169 @@
+/*
+ * Sun mouse on a software UART.
+ *
+ * The mouse talks the Mouse Systems protocol at 1200 baud: a sync
+ * byte 10000LMR with the buttons active low, then two x/y delta pairs,
+ * y counting up. On the free running timer 1 (timer.c) the input
+ * capture catches the start bit edge in hardware, so the interrupt
+ * may come late without shifting the bit timing. Compare A then
+ * samples the middle of every bit.
+ *
+ * Both handlers enable interrupts again first thing, the USB interrupt
+ * only waits for the vector jump. They only shift bits and queue whole
+ * bytes, packets are decoded in the main loop. sunmouseStats.isrMax
+ * keeps the longest handler run, measured on timer 1, a USB interrupt
+ * coming in between is counted with it.
+ */
+#include <util/atomic.h>
+
+#include "sun_defs.h"
+#include "timer.h"
+#include "mouse.h"
+#include "sunmouse.h"
+
+#define BIT_TICKS  (TIMER_TICKS_PER_US * 1000000L / SUNMOUSE_BAUD)
+
+// a packet is sent in one go, a longer pause starts over
+#define PACKET_GAP  30
+
+#define SUNMOUSE_SYNC_MASK  0xf8
+#define SUNMOUSE_SYNC       0x80
+
+#define RX_SIZE  8
+
+static volatile uint8_t rxBuf[RX_SIZE];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+
+// byte being received, bits shifted in so far
+static uint8_t shift;
+static uint8_t bits;
+
+volatile SunMouseStats sunmouseStats;
+
+#if SUNMOUSE_INVERTED
+#define LINE_MARK()  (!(PINB & (1 << PB0)))
+#else
+#define LINE_MARK()  (PINB & (1 << PB0))
+#endif
+
+static void isrTime(uint16_t start)
+{
+  uint16_t t = timerTicks() - start;
+
+  if (t > sunmouseStats.isrMax)
+    sunmouseStats.isrMax = t;
+}
+
+// start bit edge: first sample in the middle of data bit 0
+ISR(TIMER1_CAPT_vect, ISR_NOBLOCK)
+{
+  uint16_t start;
+
+  TIMER_WAKE();
+  start = timerTicks();
+
+  // the keyboard interrupt reads TCNT1 through the same temp register
+  ATOMIC_BLOCK(ATOMIC_FORCEON)
+    {
+      OCR1A = ICR1 + BIT_TICKS + BIT_TICKS / 2;
+    }
+  TIFR = 1 << OCF1A;
+  TIMSK = (TIMSK & ~(1 << TICIE1)) | (1 << OCIE1A);
+  bits = 0;
+
+  isrTime(start);
+}
+
+// eight data bits lsb first, then the stop bit
+ISR(TIMER1_COMPA_vect, ISR_NOBLOCK)
+{
+  uint16_t start;
+  uint8_t next;
+
+  TIMER_WAKE();
+  start = timerTicks();
+
+  if (bits < 8)
+    {
+      shift >>= 1;
+      if (LINE_MARK())
+        shift |= 0x80;
+      bits++;
+      ATOMIC_BLOCK(ATOMIC_FORCEON)
+        {
+          OCR1A += BIT_TICKS;
+        }
+    }
+  else
+    {
+      next = (rxHead + 1) & (RX_SIZE - 1);
+      if (LINE_MARK() && next != rxTail)
+        {
+          rxBuf[rxHead] = shift;
+          rxHead = next;
+        }
+      else
+        sunmouseStats.errors++;
+
+      // wait for the next start bit
+      TIFR = 1 << ICF1;
+      TIMSK = (TIMSK & ~(1 << OCIE1A)) | (1 << TICIE1);
+    }
+
+  isrTime(start);
+}
+
+void sunmouseInit()
+{
+  DDRB &= ~(1 << PB0);
+#if !SUNMOUSE_INVERTED
+  PORTB |= 1 << PB0;
+#endif
+
+  // noise canceler, capture on the start bit edge
+  TCCR1B |= (1 << ICNC1) | (SUNMOUSE_INVERTED ? (1 << ICES1) : 0);
+  TIFR = 1 << ICF1;
+  TIMSK |= 1 << TICIE1;
+}
+
+// decode the bytes received so far, deltas go to the mouse report
+// as soon as a pair is complete
+void sunmousePoll(uint16_t now)
+{
+  static uint8_t packet[5];
+  static uint8_t got = 0;
+  static uint16_t last;
+  uint8_t b;
+
+  if (got && (uint16_t)(now - last) > PACKET_GAP)
+    got = 0;
+
+  while (rxTail != rxHead)
+    {
+      b = rxBuf[rxTail];
+      rxTail = (rxTail + 1) & (RX_SIZE - 1);
+      last = now;
+
+      if (got == 0)
+        {
+          if ((b & SUNMOUSE_SYNC_MASK) != SUNMOUSE_SYNC)
+            continue;
+
+          // left, middle, right to report bits 0, 2, 1
+          b = ~b;
+          mouseButtons(((b >> 2) & 1) | ((b & 1) << 1) | ((b & 2) << 1));
+        }
+
+      packet[got++] = b;
+
+      if (got == 3 || got == 5)
+        mouseMove((int8_t)packet[got - 2], -(int8_t)packet[got - 1]);
+
+      if (got == 5)
+        {
+          got = 0;
+          sunmouseStats.packets++;
+        }
+    }
+}
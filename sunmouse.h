@@ -0,0 +1,27 @@
+#ifndef SUNMOUSE_HEADER_H
+# define SUNMOUSE_HEADER_H
+
+#include <stdint.h>
+
+// the mouse line comes in on ICP1 (PB0) without an inverter:
+// idle low, start bit high, like on the mini-DIN.
+#ifndef SUNMOUSE_INVERTED
+#define SUNMOUSE_INVERTED  1
+#endif
+
+#define SUNMOUSE_BAUD  1200
+
+// counters reported by VREQ_SUNMOUSE_GET
+typedef struct
+{
+  uint16_t isrMax;     // longest receive interrupt, timer 1 ticks of 0.5 us
+  uint16_t packets;    // complete packets decoded
+  uint16_t errors;     // bytes with a bad stop bit or lost to a full buffer
+} SunMouseStats;
+
+extern volatile SunMouseStats sunmouseStats;
+
+void sunmouseInit(void);
+void sunmousePoll(uint16_t now);
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Dual-role keys: one entry when tapped, another when held.
+ *
+ * Sits between the USART bytes and the combos. While a dual-role
+ * key is undecided every following byte is kept back, once it is
+ * decided the tap or hold entry is queued first and the kept bytes
+ * follow, so the host sees the keys in the order they were typed.
+ * Only one key is decided at a time, a dual-role key pressed while
+ * another one is held acts as its tap entry.
+ */
+#include <avr/pgmspace.h>
+
+#include "sun_defs.h"
+#include "keymap.h"
+#include "events.h"
+#include "combo.h"
+#include "taphold.h"
+
+// {tap, hold} entries, indexed by the value of a KC_TAPHOLD entry
+static const uint16_t tapholdKeys[][2] PROGMEM = {
+  { USB_KEY_ESCAPE,      KEYMAP_ENTRY(KC_MODIFIER, USB_MOD_LCTRL) },  // 0: Caps
+  { USB_KEY_APPLICATION, KEYMAP_ENTRY(KC_MODIFIER, USB_MOD_RCTRL) },  // 1: Compose
+};
+
+#define TAPHOLD_KEYS  (sizeof tapholdKeys / sizeof *tapholdKeys)
+
+// key waiting for the decision, 0 if none
+static uint8_t pendingKey = 0;
+static uint8_t pendingIndex;
+static uint16_t pendingSince;
+
+// key decided as a hold, 0 if none
+static uint8_t heldKey = 0;
+static uint8_t heldIndex;
+static uint8_t interrupted;
+
+static uint8_t buffer[TAPHOLD_BUFFER];
+static uint8_t buffered = 0;
+
+uint16_t tapholdEntry(uint8_t n, uint8_t hold)
+{
+  if (n >= TAPHOLD_KEYS)
+    return 0;
+
+  return pgm_read_word(&(tapholdKeys[n][hold ? 1 : 0]));
+}
+
+static void tap(uint8_t n, uint16_t now)
+{
+  uint16_t entry = tapholdEntry(n, 0);
+
+  comboFeed(EVENT_KEY(entry, 0), now);
+  comboFeed(EVENT_KEY(entry, 1), now);
+}
+
+// pass the kept bytes on, they may start the next decision
+static void flush(uint16_t now)
+{
+  uint8_t kept[TAPHOLD_BUFFER];
+  uint8_t i, n = buffered;
+
+  for (i = 0; i < n; i++)
+    kept[i] = buffer[i];
+  buffered = 0;
+
+  for (i = 0; i < n; i++)
+    tapholdFeed(kept[i], now);
+}
+
+static void hold(uint16_t now)
+{
+  heldKey = pendingKey;
+  heldIndex = pendingIndex;
+  interrupted = 0;
+  pendingKey = 0;
+
+  comboFeed(EVENT_KEY(tapholdEntry(heldIndex, 1), 0), now);
+  flush(now);
+}
+
+#if TAPHOLD_PERMISSIVE
+// was the key of this release pressed after the pending key?
+static uint8_t pressedSince(uint8_t sc)
+{
+  uint8_t i;
+
+  for (i = 0; i < buffered; i++)
+    if (buffer[i] == sc)
+      return 1;
+
+  return 0;
+}
+#endif
+
+void tapholdFeed(uint8_t rb, uint16_t now)
+{
+  uint16_t entry;
+
+  if (pendingKey)
+    {
+      if (rb == (pendingKey | 0x80))
+        {
+          pendingKey = 0;
+          tap(pendingIndex, now);
+          flush(now);
+          return;
+        }
+
+#if TAPHOLD_PERMISSIVE
+      if ((rb & 0x80) && pressedSince(rb & 0x7f))
+        {
+          hold(now);
+          tapholdFeed(rb, now);
+          return;
+        }
+#endif
+
+      if (buffered < sizeof buffer)
+        {
+          buffer[buffered++] = rb;
+          return;
+        }
+
+      // no room to wait any longer, the user is holding it
+      hold(now);
+      tapholdFeed(rb, now);
+      return;
+    }
+
+  if (heldKey && rb == (heldKey | 0x80))
+    {
+      heldKey = 0;
+      comboFeed(EVENT_KEY(tapholdEntry(heldIndex, 1), 1), now);
+#if TAPHOLD_RETRO
+      if (!interrupted)
+        tap(heldIndex, now);
+#endif
+      return;
+    }
+
+  if (!(rb & 0x80))
+    {
+      entry = keymapPeek(rb);
+      if ((entry >> 8) == KC_TAPHOLD && !heldKey)
+        {
+          pendingKey = rb;
+          pendingIndex = entry & 0xff;
+          pendingSince = now;
+          return;
+        }
+
+      interrupted = 1;
+    }
+
+  comboFeed(rb, now);
+}
+
+// decide on the hold once the tapping term is over
+void tapholdPoll(uint16_t now)
+{
+  if (pendingKey && (uint16_t)(now - pendingSince) >= TAPHOLD_TERM)
+    hold(now);
+}
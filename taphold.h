@@ -0,0 +1,37 @@
+#ifndef TAPHOLD_HEADER_H
+# define TAPHOLD_HEADER_H
+
+#include <stdint.h>
+
+// released within the tapping term (ms) the key is a tap,
+// held longer it is a hold.
+#ifndef TAPHOLD_TERM
+# define TAPHOLD_TERM        200
+#endif
+
+// another key pressed and released while undecided makes it a hold
+#ifndef TAPHOLD_PERMISSIVE
+# define TAPHOLD_PERMISSIVE  1
+#endif
+
+// a hold released without any other key pressed still sends the tap
+#ifndef TAPHOLD_RETRO
+# define TAPHOLD_RETRO       0
+#endif
+
+// bytes kept back while a key is undecided
+#define TAPHOLD_BUFFER       8
+
+#ifdef WITH_TAPHOLD
+uint16_t tapholdEntry(uint8_t n, uint8_t hold);
+void tapholdFeed(uint8_t rb, uint16_t now);
+void tapholdPoll(uint16_t now);
+#else
+// bytes go straight on to the combo stage, dual-role keys do nothing
+# include "combo.h"
+# define tapholdEntry(n, hold)  0
+# define tapholdFeed(rb, now)   comboFeed(rb, now)
+# define tapholdPoll(now)
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ * Host build: the EEPROM variables live in RAM, zeroed.
+ */
+#ifndef HOST_AVR_EEPROM_H
+# define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+
+#define EEMEM
+
+#define eeprom_is_ready()          1
+#define eeprom_read_byte(p)        (*(const uint8_t *)(p))
+#define eeprom_update_byte(p, v)   (*(uint8_t *)(p) = (v))
+#define eeprom_write_byte(p, v)    (*(uint8_t *)(p) = (v))
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOST_AVR_INTERRUPT_H
+# define HOST_AVR_INTERRUPT_H
+
+#define ISR(vector, ...)  void vector(void)
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define sei()
+#define cli()
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Host build: the I/O registers the core touches are plain bytes.
+ */
+#ifndef HOST_AVR_IO_H
+# define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+extern volatile uint8_t hostRegs[64];
+
+#define PORTB   hostRegs[0x18]
+#define MCUCSR  hostRegs[0x34]
+
+#define PB0     0
+#define PB1     1
+#define PB2     2
+#define PB3     3
+#define PORF    0
+#define EXTRF   1
+#define BORF    2
+#define WDRF    3
+
+#define _BV(b)  (1 << (b))
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_AVR_WDT_H
+# define HOST_AVR_WDT_H
+
+#define wdt_reset()
+#define wdt_enable(t)
+
+#endif
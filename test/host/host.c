@@ -0,0 +1,36 @@
+/*
+ * Host build: the hardware side of the core, faked.
+ */
+#include "avr/io.h"
+#include "host.h"
+#include "../../timer.h"
+#include "../../translate.h"
+
+volatile uint8_t hostRegs[64];
+
+uint16_t hostNow = 0;
+
+uint8_t hostSent[16];
+uint8_t hostSentCount = 0;
+
+uint16_t timerNow()
+{
+  return hostNow;
+}
+
+// 0.5 us ticks of the same clock
+uint16_t timerTicks()
+{
+  return hostNow * 2000;
+}
+
+uint32_t timerStamp()
+{
+  return hostNow * 2000UL;
+}
+
+void keyboardSend(uint8_t cmd)
+{
+  if (hostSentCount < sizeof hostSent)
+    hostSent[hostSentCount++] = cmd;
+}
@@ -0,0 +1,13 @@
+#ifndef HOST_HEADER_H
+# define HOST_HEADER_H
+
+#include <stdint.h>
+
+// the millisecond clock the host build runs on, set by the tests
+extern uint16_t hostNow;
+
+// commands sent to the keyboard with keyboardSend()
+extern uint8_t hostSent[16];
+extern uint8_t hostSentCount;
+
+#endif
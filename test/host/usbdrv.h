@@ -0,0 +1,10 @@
+/*
+ * Host build: the few driver types sun_defs.h needs.
+ */
+#ifndef HOST_USBDRV_H
+# define HOST_USBDRV_H
+
+typedef unsigned char uchar;
+typedef unsigned usbMsgLen_t;
+
+#endif
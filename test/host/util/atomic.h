@@ -0,0 +1,9 @@
+#ifndef HOST_UTIL_ATOMIC_H
+# define HOST_UTIL_ATOMIC_H
+
+// one pass, nothing interrupts the host build
+#define ATOMIC_BLOCK(type)  for (int atomicOnce = 1; atomicOnce; atomicOnce = 0)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_UTIL_DELAY_H
+# define HOST_UTIL_DELAY_H
+
+#define _delay_ms(ms)
+#define _delay_us(us)
+
+#endif
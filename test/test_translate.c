@@ -0,0 +1,555 @@
+/*
+ * Tests of the Sun byte -> keyboard report core, built for the host.
+ *
+ * Every one of the 256 bytes is fed on its own and the report is
+ * checked against layer 0 of the first profile in sunkeycodes, then
+ * press, release and rollover sequences, and keys held across a
+ * profile, remap or layout change. `make test` builds and runs it.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "../sun_defs.h"
+#include "../keymap.h"
+#include "../remap.h"
+#include "../taphold.h"
+#include "../combo.h"
+#include "../leader.h"
+#include "../macro.h"
+#include "../consumer.h"
+#include "../turbo.h"
+#include "../mouse.h"
+#include "../translate.h"
+#include "host/host.h"
+
+// profile 0, layer 0 comes first
+extern const uint16_t sunkeycodes[];
+
+// long enough for every term, timeout and macro to run out
+#define SETTLE  (LEADER_TIMEOUT + TAPHOLD_TERM + 500)
+
+#define LOG_SIZE  64
+
+static unsigned checks = 0;
+static unsigned failures = 0;
+
+#define CHECK(cond, ...)                                  \
+  do                                                      \
+    {                                                     \
+      checks++;                                           \
+      if (!(cond))                                        \
+        {                                                 \
+          failures++;                                     \
+          printf("%s:%d: ", __FILE__, __LINE__);          \
+          printf(__VA_ARGS__);                            \
+          printf("\n");                                   \
+        }                                                 \
+    }                                                     \
+  while (0)
+
+// reports sent by the last run(), and the live one after it
+static uint8_t log[LOG_SIZE][KEYBOARD_REPORT_SIZE];
+static unsigned logCount;
+static uint8_t out[KEYBOARD_REPORT_SIZE];
+static uint8_t mouseOut[MOUSE_REPORT_SIZE];
+static uint8_t consumerOut[3];
+static unsigned consumerCount;
+
+// the main loop for ms milliseconds, the host polls every 1 ms
+static void run(unsigned ms)
+{
+  logCount = 0;
+  consumerCount = 0;
+
+  while (ms--)
+    {
+      hostNow++;
+      translatePoll(hostNow);
+      turboPoll(hostNow);
+      consumerPoll(hostNow);
+      mousePoll(hostNow);
+      mouseReport(mouseOut);
+      if (consumerReport(consumerOut))
+        consumerCount++;
+      if (translateStep(hostNow))
+        {
+          translateReport(out);
+          if (logCount < LOG_SIZE)
+            memcpy(log[logCount], out, sizeof out);
+          logCount++;
+        }
+    }
+
+  translateReport(out);
+}
+
+static void feed(uint8_t rb, unsigned ms)
+{
+  translateByte(rb, hostNow);
+  run(ms);
+}
+
+static int reportEmpty(const uint8_t *r)
+{
+  uint8_t i;
+
+  for (i = 1; i < KEYBOARD_REPORT_SIZE; i++)
+    if (r[i])
+      return 0;
+
+  return r[0] == REPORT_ID_KEYBOARD;
+}
+
+static int reportHas(const uint8_t *r, uint8_t usage)
+{
+  uint8_t i;
+
+  for (i = 2; i < KEYBOARD_REPORT_SIZE; i++)
+    if (r[i] == usage)
+      return 1;
+
+  return 0;
+}
+
+static unsigned reportKeys(const uint8_t *r)
+{
+  unsigned i, n = 0;
+
+  for (i = 2; i < KEYBOARD_REPORT_SIZE; i++)
+    if (r[i])
+      n++;
+
+  return n;
+}
+
+static int logHas(uint8_t usage)
+{
+  unsigned i;
+
+  for (i = 0; i < logCount && i < LOG_SIZE; i++)
+    if (reportHas(log[i], usage))
+      return 1;
+
+  return 0;
+}
+
+// a report of the last run() with the usage and these modifiers
+static int logHasWith(uint8_t mods, uint8_t usage)
+{
+  unsigned i;
+
+  for (i = 0; i < logCount && i < LOG_SIZE; i++)
+    if (log[i][1] == mods && reportHas(log[i], usage))
+      return 1;
+
+  return 0;
+}
+
+// the report while sc is held, as layer 0 has it
+static void checkPress(uint8_t sc)
+{
+  uint16_t entry = sunkeycodes[sc];
+  uint8_t cls = entry >> 8, value = entry & 0xff;
+
+  if (cls == KC_TAPHOLD)
+    {
+      // held past the tapping term
+      entry = tapholdEntry(value, 1);
+      cls = entry >> 8;
+      value = entry & 0xff;
+    }
+
+  switch (cls)
+    {
+    case KC_NORMAL:
+      if (entry == 0)
+        CHECK(reportEmpty(out) && logCount == 0, "%02x: no key, but a report", sc);
+      else
+        CHECK(out[1] == 0 && out[2] == value && reportKeys(out) == 1,
+              "%02x: usage %02x expected, report %02x %02x", sc, value, out[1], out[2]);
+      break;
+
+    case KC_MODIFIER:
+      CHECK(out[1] == value && reportKeys(out) == 0,
+            "%02x: modifiers %02x expected, got %02x", sc, value, out[1]);
+      break;
+
+    case KC_MACRO:
+      CHECK(macroGet(value) == 0 || logCount > 0, "%02x: macro %u not typed", sc, value);
+      CHECK(reportEmpty(out), "%02x: macro left keys in the report", sc);
+      break;
+
+    case KC_CONSUMER:
+      CHECK(reportEmpty(out), "%02x: consumer key in the keyboard report", sc);
+      CHECK(consumerOut[1] == value, "%02x: consumer usage %02x expected", sc, value);
+      break;
+
+    case KC_LAYER:
+      CHECK(reportEmpty(out), "%02x: layer key in the report", sc);
+      if (value < 4)
+        CHECK(keymapLayer() == value, "%02x: layer %u expected, %u active", sc, value, keymapLayer());
+      break;
+
+    default:
+      CHECK(reportEmpty(out), "%02x: class %u changed the report", sc, cls);
+      break;
+    }
+}
+
+// every byte on its own: a press is checked against the table and
+// released again, a release without a press changes nothing
+static void testAllBytes()
+{
+  unsigned b;
+
+  for (b = 0; b < 256; b++)
+    {
+      if (b == SKBD_RESET || b == SKBD_LYOUT)
+        continue;
+
+      if (b < 0x80)
+        {
+          feed(b, SETTLE);
+          checkPress(b);
+
+          feed(b | 0x80, SETTLE);
+          CHECK(reportEmpty(out), "%02x: report not empty after the release", b);
+          CHECK(keymapLayer() == 0, "%02x: layer %u left active", b, keymapLayer());
+          CHECK(consumerOut[1] == 0, "%02x: consumer usage left on", b);
+        }
+      else
+        {
+          // may send the same empty report again, nothing more
+          feed(b, SETTLE);
+          CHECK(reportEmpty(out), "%02x: release of a key not held changed the report", b);
+        }
+    }
+
+  // the byte after reset and layout is no key
+  feed(SKBD_RESET, 10);
+  feed(0x04, SETTLE);
+  CHECK(logCount == 0 && reportEmpty(out), "reset reply sent a report");
+
+  feed(SKBD_LYOUT, 10);
+  feed(SKBD_LAYOUT_US5, SETTLE);
+  CHECK(logCount == 0 && reportEmpty(out), "layout reply sent a report");
+}
+
+// the first n scancodes with plain usages, no combo keys
+static unsigned normalKeys(uint8_t *sc, unsigned n)
+{
+  unsigned b, found = 0;
+
+  for (b = 0; b < 0x7f && found < n; b++)
+    if (sunkeycodes[b] && (sunkeycodes[b] >> 8) == KC_NORMAL && !keymapComboKey(b))
+      sc[found++] = b;
+
+  return found;
+}
+
+static void testRollover()
+{
+  uint8_t sc[7];
+  unsigned i;
+
+  CHECK(normalKeys(sc, 7) == 7, "not enough plain keys");
+
+  for (i = 0; i < 6; i++)
+    {
+      feed(sc[i], 20);
+      CHECK(reportKeys(out) == i + 1 && reportHas(out, sunkeycodes[sc[i]]),
+            "rollover: key %u of 6 missing", i + 1);
+    }
+
+  // a seventh doesn't fit and doesn't push one out
+  feed(sc[6], 20);
+  CHECK(reportKeys(out) == 6 && !reportHas(out, sunkeycodes[sc[6]]), "rollover: seventh key in the report");
+  feed(sc[6] | 0x80, 20);
+  CHECK(reportKeys(out) == 6, "rollover: release of the seventh key changed the report");
+
+  // released in another order than pressed
+  feed(sc[2] | 0x80, 20);
+  CHECK(reportKeys(out) == 5 && !reportHas(out, sunkeycodes[sc[2]]), "rollover: third key not released");
+  feed(sc[2], 20);
+  CHECK(reportKeys(out) == 6 && reportHas(out, sunkeycodes[sc[2]]), "rollover: free slot not reused");
+
+  for (i = 0; i < 6; i++)
+    feed(sc[i] | 0x80, 20);
+  CHECK(reportEmpty(out), "rollover: report not empty at the end");
+}
+
+static void testSequences()
+{
+  uint8_t sc[2], shift = 0, b;
+
+  normalKeys(sc, 2);
+  for (b = 0; b < 0x7f; b++)
+    if ((sunkeycodes[b] >> 8) == KC_MODIFIER)
+      {
+        shift = b;
+        break;
+      }
+
+  // two presses at once still go out as two reports
+  translateByte(sc[0], hostNow);
+  translateByte(sc[1], hostNow);
+  run(1);
+  CHECK(logCount == 1 && reportKeys(out) == 1 && reportHas(out, sunkeycodes[sc[0]]),
+        "one edge per report: first report");
+  run(1);
+  CHECK(logCount == 1 && reportKeys(out) == 2, "one edge per report: second report");
+
+  feed(sc[0] | 0x80, 5);
+  CHECK(reportKeys(out) == 1 && reportHas(out, sunkeycodes[sc[1]]), "release: the other key stays");
+  feed(sc[1] | 0x80, 5);
+  CHECK(reportEmpty(out), "release: report not empty");
+
+  // modifier and key
+  CHECK(shift != 0, "no modifier on layer 0");
+  feed(shift, 5);
+  feed(sc[0], 5);
+  CHECK(out[1] == (sunkeycodes[shift] & 0xff) && reportHas(out, sunkeycodes[sc[0]]),
+        "modifier + key: report %02x %02x", out[1], out[2]);
+  feed(sc[0] | 0x80, 5);
+  feed(shift | 0x80, 5);
+  CHECK(reportEmpty(out), "modifier + key: report not empty");
+
+  // Caps Lock tapped is Escape, pressed and released right away
+  feed(0x77, 30);
+  CHECK(reportEmpty(out), "tap-hold: decided before the release");
+  feed(0x77 | 0x80, 30);
+  CHECK(logHas(USB_KEY_ESCAPE) && reportEmpty(out), "tap-hold: tap sent no Escape");
+
+  // held with another key tapped, it is Ctrl
+  feed(0x77, 10);
+  feed(sc[0], 10);
+  feed(sc[0] | 0x80, 10);
+  CHECK(!logHas(USB_KEY_ESCAPE), "tap-hold: permissive hold sent Escape");
+  CHECK(logHasWith(USB_MOD_LCTRL, sunkeycodes[sc[0]]), "tap-hold: key not sent with Ctrl");
+  feed(0x77 | 0x80, SETTLE);
+  CHECK(reportEmpty(out), "tap-hold: report not empty");
+}
+
+// keys held across a profile, remap or layout change are released
+// with what they were pressed as
+static void testRekey()
+{
+  uint8_t sc[1];
+
+  normalKeys(sc, 1);
+
+  // Copy + Paste is Pause
+  feed(SKBD_COPY, 10);
+  feed(SKBD_PASTE, 10);
+  CHECK(reportKeys(out) == 1 && reportHas(out, 0x48), "combo: no Pause");
+  feed(SKBD_PASTE | 0x80, 10);
+  feed(SKBD_COPY | 0x80, 10);
+  CHECK(reportEmpty(out), "combo: report not empty");
+
+  // Meta held, Stop + Open: the PC profile has Alt there
+  feed(0x78, 10);
+  CHECK(out[1] == USB_MOD_LGUI, "profile: Meta is %02x in the Sun profile", out[1]);
+  feed(SKBD_STOP, 10);
+  feed(SKBD_OPEN, 10);
+  feed(SKBD_OPEN | 0x80, 10);
+  feed(SKBD_STOP | 0x80, 10);
+  CHECK(keymapProfileActive() == 1, "profile: PC profile not active");
+  CHECK(out[1] == USB_MOD_LALT && reportKeys(out) == 0, "profile: Meta held is %02x", out[1]);
+  feed(0x78 | 0x80, 10);
+  CHECK(reportEmpty(out), "profile: Meta stuck after the switch");
+
+  feed(SKBD_STOP, 10);
+  feed(SKBD_FRONT, 10);
+  feed(SKBD_FRONT | 0x80, 10);
+  feed(SKBD_STOP | 0x80, 10);
+  CHECK(keymapProfileActive() == 0, "profile: Sun profile not active");
+
+  // a one-shot layer armed before a remap is still there after it
+  feed(sc[0], 10);
+  feed(SKBD_HELP, 10);
+  feed(KEY_COMPOSE, 10);
+  feed(KEY_COMPOSE | 0x80, 10);
+  feed(SKBD_HELP | 0x80, 10);
+  translateRemap(0x10, 0x04);
+  run(10);
+  feed(sc[0] | 0x80, 10);
+  feed(0x45, 10);
+  CHECK(reportKeys(out) == 1 && reportHas(out, 0x52), "one-shot: KP 8 isn't Up after a remap");
+  feed(0x45 | 0x80, 10);
+  translateRemap(0x10, 0);
+  run(10);
+  CHECK(reportEmpty(out) && keymapLayer() == 0, "one-shot: report or layer left");
+
+  // remapped while held
+  feed(sc[0], 10);
+  translateRemap(sc[0], USB_KEY_TAB);
+  run(10);
+  CHECK(reportKeys(out) == 1 && reportHas(out, USB_KEY_TAB), "remap: held key not remapped");
+  feed(sc[0] | 0x80, 10);
+  CHECK(reportEmpty(out), "remap: key stuck after the remap");
+
+  translateRemapClear();
+  feed(sc[0], 10);
+  CHECK(reportHas(out, sunkeycodes[sc[0]]), "remap: not cleared");
+  feed(sc[0] | 0x80, 10);
+
+  // ` ~ held, the layout reply says type 5 UNIX: it is \ | there
+  feed(0x2a, 10);
+  CHECK(reportHas(out, sunkeycodes[0x2a]), "layout: no ` ~");
+  feed(SKBD_LYOUT, 1);
+  feed(SKBD_LAYOUT_US5_UNIX, 10);
+  CHECK(reportKeys(out) == 1 && reportHas(out, 0x31), "layout: held key not rekeyed");
+  feed(0x2a | 0x80, 10);
+  CHECK(reportEmpty(out), "layout: key stuck after the layout reply");
+
+  feed(SKBD_LYOUT, 1);
+  feed(SKBD_LAYOUT_US5, 10);
+}
+
+// leader sequences that break off or run out type what was swallowed
+static void testLeader()
+{
+  // Help tapped, G: a prefix, swallowed. A ends it, G goes first
+  feed(SKBD_HELP, 10);
+  feed(SKBD_HELP | 0x80, 10);
+  feed(0x51, 10);
+  feed(0xd1, 10);
+  CHECK(!logHas(0x0a), "leader: prefix not swallowed");
+  feed(0x4d, 10);
+  CHECK(logCount == 3 && reportHas(log[0], 0x0a) && reportEmpty(log[1]) && reportHas(out, 0x04),
+        "leader: swallowed G not typed before A, %u reports", logCount);
+  feed(0xcd, 10);
+  CHECK(reportEmpty(out), "leader: A stuck");
+
+  // a prefix left alone runs out on the clock the tests drive
+  feed(SKBD_HELP, 10);
+  feed(SKBD_HELP | 0x80, 10);
+  feed(0x51, 10);
+  feed(0xd1, LEADER_TIMEOUT - 30);
+  CHECK(!logHas(0x0a), "leader: timed out early");
+  run(30);
+  CHECK(logHas(0x0a) && reportEmpty(out), "leader: G not typed on the timeout");
+
+  // Help, G, C is a macro: C held isn't pressed again by a remap
+  feed(SKBD_HELP, 10);
+  feed(SKBD_HELP | 0x80, 10);
+  feed(0x51, 10);
+  feed(0xd1, 10);
+  feed(0x66, SETTLE);
+  translateRemap(0x10, 0x04);
+  run(10);
+  CHECK(!reportHas(out, 0x06), "leader: consumed key pressed again");
+  feed(0xe6, 10);
+  translateRemap(0x10, 0);
+  run(10);
+  CHECK(reportEmpty(out), "leader: report not empty");
+}
+
+// the EEPROM copy of the remap table across resets
+static void testRemapStore()
+{
+  unsigned i;
+
+  translateRemap(0x10, 0x04);
+  translateRemap(0x11, 0x05);
+  translateRemap(0x12, 0x06);
+  for (i = 0; i < 40; i++)
+    remapPoll();
+  remapInit();
+  CHECK(remapCount == 3 && remapLookup(0x11) == 0x05, "remap store: %u pairs after a reset", remapCount);
+
+  // shrunk, and reset halfway through writing it back: empty, no
+  // count over old and new pairs
+  translateRemap(0x10, 0);
+  for (i = 0; i < 3; i++)
+    remapPoll();
+  remapInit();
+  CHECK(remapCount == 0, "remap store: %u pairs after a reset while writing", remapCount);
+
+  translateRemap(0x11, 0x05);
+  translateRemap(0x12, 0x06);
+  for (i = 0; i < 40; i++)
+    remapPoll();
+  remapInit();
+  CHECK(remapCount == 2 && remapLookup(0x10) == 0 && remapLookup(0x12) == 0x06,
+        "remap store: %u pairs after shrinking", remapCount);
+
+  translateRemapClear();
+  for (i = 0; i < 40; i++)
+    remapPoll();
+}
+
+// volume repeats while held, mute is sent once
+static void testConsumerRepeat()
+{
+  unsigned i, reports;
+
+  feed(0x2d, 2000);
+  CHECK(consumerCount == 1 && consumerOut[1] == CKEY_Mute, "mute: %u reports while held", consumerCount);
+  feed(0xad, 10);
+  CHECK(consumerCount == 1 && consumerOut[1] == 0, "mute: not released");
+
+  feed(0x04, 2000);
+  CHECK(consumerCount > 10 && consumerOut[1] == CKEY_VolumeUp, "volume: %u reports in 2 s", consumerCount);
+
+  // still at the top rate after the 16 bit tick wrapped at 65.5 s
+  for (i = 0; i < 64; i++)
+    run(1000);
+  run(1000);
+  reports = consumerCount;
+  CHECK(reports >= 30, "volume: %u reports from 66 to 67 s", reports);
+  feed(0x84, 10);
+  CHECK(consumerOut[1] == 0, "volume: not released");
+}
+
+// turbo on a mouse button, released right after a turbo release
+static void testTurboMouse()
+{
+  // Fn + Scroll Lock: mouse keys, KP 5 is button 1
+  feed(0x76, 10);
+  feed(0x17, 10);
+  feed(0x97, 10);
+  feed(0xf6, SETTLE);
+
+  turboSet(0x5c, 1);
+  turboRate(30);
+
+  // one edge after 17 ms, a release
+  feed(0x5c, 5);
+  CHECK(mouseOut[0] == 1, "turbo: button not pressed");
+  run(20);
+  CHECK(mouseOut[0] == 0, "turbo: no release edge");
+  feed(0xdc, 50);
+  CHECK(mouseOut[0] == 0, "turbo: button down after the release");
+
+  // the count didn't wrap: it still goes down and up
+  turboSet(0x5c, 0);
+  feed(0x5c, 10);
+  CHECK(mouseOut[0] == 1, "turbo: button count wrapped");
+  feed(0xdc, 10);
+  CHECK(mouseOut[0] == 0, "turbo: button stuck");
+
+  feed(0x76, 10);
+  feed(0x17, 10);
+  feed(0x97, 10);
+  feed(0xf6, SETTLE);
+  CHECK(keymapLayer() == 0, "turbo: mouse layer left on");
+}
+
+int main()
+{
+  remapInit();
+  keymapInit();
+
+  testAllBytes();
+  testRollover();
+  testSequences();
+  testRekey();
+  testLeader();
+  testRemapStore();
+  testTurboMouse();
+  testConsumerRepeat();
+
+  printf("%u checks, %u failed\n", checks, failures);
+  return failures != 0;
+}
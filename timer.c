@@ -0,0 +1,78 @@
+/*
+ * Millisecond tick on Timer2.
+ *
+ * CTC mode at clk/64, the compare match fires every 1 ms. The handler
+ * enables interrupts again right away, so the USB interrupt never
+ * waits for it.
+ *
+ * Timer 1 runs free at clk/8 next to it, 0.5 us ticks for measuring
+ * short things. Its capture and compare units belong to sunmouse.c.
+ */
+#include <util/atomic.h>
+
+#include "sun_defs.h"
+#include "timer.h"
+
+#define TIMER_PRESCALE  64
+
+static volatile uint16_t millis = 0;
+
+volatile uint8_t timerAsleep = 0;
+volatile uint16_t timerWoke;
+
+ISR(TIMER2_COMP_vect, ISR_NOBLOCK)
+{
+  TIMER_WAKE();
+
+  // a handler coming in between must not see half of it
+  ATOMIC_BLOCK(ATOMIC_FORCEON)
+    {
+      millis++;
+    }
+}
+
+void timerInit()
+{
+  OCR2 = F_CPU / TIMER_PRESCALE / 1000 - 1;
+  TCCR2 = (1 << WGM21) | (1 << CS22);
+  TIMSK |= (1 << OCIE2);
+
+  TCCR1A = 0;
+  TCCR1B = 1 << CS11;
+}
+
+uint16_t timerNow()
+{
+  uint16_t now;
+
+  // two byte read, the tick may come in between
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      now = millis;
+    }
+
+  return now;
+}
+
+uint16_t timerTicks()
+{
+  uint16_t ticks;
+
+  // the timer 1 handlers use the shared 16 bit temp register too
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      ticks = TCNT1;
+    }
+
+  return ticks;
+}
+
+// timer 1 carried on to 32 bits, wraps after 35 minutes. only from
+// the main loop, which has to call it once per 32 ms wrap at least.
+uint32_t timerStamp()
+{
+  static uint32_t stamp = 0;
+
+  stamp += (uint16_t)(timerTicks() - (uint16_t)stamp);
+  return stamp;
+}
@@ -0,0 +1,36 @@
+#ifndef TIMER_HEADER_H
+# define TIMER_HEADER_H
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+// milliseconds since timerInit(), wraps after 65 s.
+// compare with (uint16_t)(now - then).
+void timerInit(void);
+uint16_t timerNow(void);
+
+// timer 1, 0.5 us ticks, wraps every 32 ms
+#define TIMER_TICKS_PER_US  2
+uint16_t timerTicks(void);
+uint32_t timerStamp(void);
+
+// sleep accounting: the main loop sets timerAsleep right before it
+// sleeps, the first handler that comes in stamps its own entry in
+// timerWoke, so its run time doesn't count as sleep.
+extern volatile uint8_t timerAsleep;
+extern volatile uint16_t timerWoke;
+
+// first thing in a handler that can wake the main loop, with
+// interrupts on: a handler nested into it must not stamp again
+#define TIMER_WAKE()                          \
+  ATOMIC_BLOCK(ATOMIC_FORCEON)                \
+    {                                         \
+      if (timerAsleep)                        \
+        {                                     \
+          timerAsleep = 0;                    \
+          timerWoke = TCNT1;                  \
+        }                                     \
+    }
+
+#endif
@@ -0,0 +1,954 @@
+/*
+ * keymapc - compile a readable keymap file into the PROGMEM tables.
+ *
+ *   keymapc KEYMAP DESCRIPTOR OUTPUT
+ *
+ * KEYMAP is the keymap file (see sun.keymap), DESCRIPTOR the header
+ * holding usbHidReportDescriptor. The usage range of the keyboard
+ * array and modifier inputs is read from the descriptor and every
+ * usage in the keymap has to fall into it. OUTPUT is only written
+ * if the keymap is valid.
+ *
+ * Builds with the host compiler, see the Makefile.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../keymap.h"
+
+#define MAX_LAYERS   4
+#define MAX_PROFILES 4
+#define MAX_LAYOUTS  16
+#define MAX_SEQUENCES  32
+#define SCANCODES    128
+
+
+typedef struct
+{
+  const char *name;
+  int usage;
+} UsageName;
+
+// mouse keys, as KC_MOUSE entries
+static const UsageName mouseNames[] = {
+  {"MS_UP", MOUSE_UP}, {"MS_DOWN", MOUSE_DOWN},
+  {"MS_LEFT", MOUSE_LEFT}, {"MS_RIGHT", MOUSE_RIGHT},
+  {"MS_UPLEFT", MOUSE_UP | MOUSE_LEFT}, {"MS_UPRIGHT", MOUSE_UP | MOUSE_RIGHT},
+  {"MS_DOWNLEFT", MOUSE_DOWN | MOUSE_LEFT}, {"MS_DOWNRIGHT", MOUSE_DOWN | MOUSE_RIGHT},
+  {"MS_BTN1", MOUSE_BUTTON | 1}, {"MS_BTN2", MOUSE_BUTTON | 2},
+  {"MS_BTN3", MOUSE_BUTTON | 4},
+  {"MS_WHUP", MOUSE_WHEEL}, {"MS_WHDOWN", MOUSE_WHEEL + 1},
+  {0, 0}
+};
+
+static const UsageName usageNames[] = {
+  {"NONE", 0x00},
+  {"A", 0x04}, {"B", 0x05}, {"C", 0x06}, {"D", 0x07}, {"E", 0x08},
+  {"F", 0x09}, {"G", 0x0a}, {"H", 0x0b}, {"I", 0x0c}, {"J", 0x0d},
+  {"K", 0x0e}, {"L", 0x0f}, {"M", 0x10}, {"N", 0x11}, {"O", 0x12},
+  {"P", 0x13}, {"Q", 0x14}, {"R", 0x15}, {"S", 0x16}, {"T", 0x17},
+  {"U", 0x18}, {"V", 0x19}, {"W", 0x1a}, {"X", 0x1b}, {"Y", 0x1c},
+  {"Z", 0x1d},
+  {"1", 0x1e}, {"2", 0x1f}, {"3", 0x20}, {"4", 0x21}, {"5", 0x22},
+  {"6", 0x23}, {"7", 0x24}, {"8", 0x25}, {"9", 0x26}, {"0", 0x27},
+  {"ENTER", 0x28}, {"ESC", 0x29}, {"BSPACE", 0x2a}, {"TAB", 0x2b},
+  {"SPACE", 0x2c}, {"MINUS", 0x2d}, {"EQUAL", 0x2e}, {"LBRACKET", 0x2f},
+  {"RBRACKET", 0x30}, {"BSLASH", 0x31}, {"NONUS_HASH", 0x32},
+  {"SCOLON", 0x33}, {"QUOTE", 0x34}, {"GRAVE", 0x35}, {"COMMA", 0x36},
+  {"DOT", 0x37}, {"SLASH", 0x38}, {"CAPSLOCK", 0x39},
+  {"F1", 0x3a}, {"F2", 0x3b}, {"F3", 0x3c}, {"F4", 0x3d}, {"F5", 0x3e},
+  {"F6", 0x3f}, {"F7", 0x40}, {"F8", 0x41}, {"F9", 0x42}, {"F10", 0x43},
+  {"F11", 0x44}, {"F12", 0x45},
+  {"PSCREEN", 0x46}, {"SCROLLLOCK", 0x47}, {"PAUSE", 0x48},
+  {"INSERT", 0x49}, {"HOME", 0x4a}, {"PGUP", 0x4b}, {"DELETE", 0x4c},
+  {"END", 0x4d}, {"PGDOWN", 0x4e}, {"RIGHT", 0x4f}, {"LEFT", 0x50},
+  {"DOWN", 0x51}, {"UP", 0x52},
+  {"NUMLOCK", 0x53}, {"KP_SLASH", 0x54}, {"KP_ASTERISK", 0x55},
+  {"KP_MINUS", 0x56}, {"KP_PLUS", 0x57}, {"KP_ENTER", 0x58},
+  {"KP_1", 0x59}, {"KP_2", 0x5a}, {"KP_3", 0x5b}, {"KP_4", 0x5c},
+  {"KP_5", 0x5d}, {"KP_6", 0x5e}, {"KP_7", 0x5f}, {"KP_8", 0x60},
+  {"KP_9", 0x61}, {"KP_0", 0x62}, {"KP_DOT", 0x63},
+  {"NONUS_BSLASH", 0x64}, {"APPLICATION", 0x65}, {"POWER", 0x66},
+  {"KP_EQUAL", 0x67},
+  {"F13", 0x68}, {"F14", 0x69}, {"F15", 0x6a}, {"F16", 0x6b},
+  {"F17", 0x6c}, {"F18", 0x6d}, {"F19", 0x6e}, {"F20", 0x6f},
+  {"F21", 0x70}, {"F22", 0x71}, {"F23", 0x72}, {"F24", 0x73},
+  {"EXECUTE", 0x74}, {"HELP", 0x75}, {"MENU", 0x76}, {"SELECT", 0x77},
+  {"STOP", 0x78}, {"AGAIN", 0x79}, {"UNDO", 0x7a}, {"CUT", 0x7b},
+  {"COPY", 0x7c}, {"PASTE", 0x7d}, {"FIND", 0x7e}, {"MUTE", 0x7f},
+  {"VOLUP", 0x80}, {"VOLDOWN", 0x81},
+  {"INT1", 0x87}, {"INT2", 0x88}, {"INT3", 0x89}, {"INT4", 0x8a},
+  {"INT5", 0x8b}, {"INT6", 0x8c}, {"INT7", 0x8d}, {"INT8", 0x8e},
+  {"INT9", 0x8f},
+  {"LANG1", 0x90}, {"LANG2", 0x91}, {"LANG3", 0x92}, {"LANG4", 0x93},
+  {"LANG5", 0x94},
+  {"LCTRL", 0xe0}, {"LSHIFT", 0xe1}, {"LALT", 0xe2}, {"LGUI", 0xe3},
+  {"RCTRL", 0xe4}, {"RSHIFT", 0xe5}, {"RALT", 0xe6}, {"RGUI", 0xe7},
+  {0, 0}
+};
+
+typedef struct
+{
+  char name[32];
+  int first, last;
+  int count;
+  int scancode[SCANCODES];
+  int usage[SCANCODES];
+} Layout;
+
+// profiles above 0 start as a copy of profile 0, only what differs
+// is written out
+static int layers[MAX_PROFILES][MAX_LAYERS][SCANCODES];
+static int layerSet[MAX_PROFILES][MAX_LAYERS][SCANCODES];
+static char layerName[MAX_LAYERS][32];
+static int layerCount = 0;
+static char profileName[MAX_PROFILES][32] = {"default"};
+static int profileCount = 1;
+
+static Layout layouts[MAX_LAYOUTS];
+static int layoutCount = 0;
+
+// key sequences, compiled into a trie: combos (sorted scancodes)
+// and leader sequences (usages, in the order typed)
+typedef struct
+{
+  int count;
+  int key[SEQUENCE_KEYS];
+  int value;
+  int line;
+} Sequence;
+
+// children of a node are first .. first + count - 1,
+// the top level is 0 .. roots - 1.
+typedef struct
+{
+  int key;
+  int first, count;
+  int value;
+} TrieNode;
+
+typedef struct
+{
+  const char *what;
+  Sequence seq[MAX_SEQUENCES];
+  int count;
+  TrieNode node[MAX_SEQUENCES * SEQUENCE_KEYS];
+  int nodes;
+  int roots;
+} Trie;
+
+static Trie combos = {"combo"};
+static Trie leaders = {"leader sequence"};
+
+// usage ranges declared by the descriptor
+static int arrayMin = -1, arrayMax = -1;
+static int modMin = -1, modMax = -1;
+static int consMin = -1, consMax = -1;
+
+static const char *keymapFile;
+static int lineNo;
+static int errors = 0;
+
+static void error(const char *msg, const char *arg)
+{
+  fprintf(stderr, "%s:%d: %s%s%s\n", keymapFile, lineNo, msg,
+          arg ? ": " : "", arg ? arg : "");
+  errors++;
+}
+
+static int parseNumber(const char *s, int *value)
+{
+  char *end;
+
+  *value = (int)strtol(s, &end, 0);
+  return *s && *end == 0;
+}
+
+// keymap entry for a usage name, number or action, -1 if unknown.
+// plain usages stay KC_NORMAL here, modifiers are packed on output.
+static int parseValue(const char *s)
+{
+  const UsageName *un;
+  int n, value;
+
+  if (sscanf(s, "MO(%i)", &n) == 1 && n >= 0 && n < MAX_LAYERS)
+    return KEYMAP_MO(n);
+  if (sscanf(s, "TG(%i)", &n) == 1 && n >= 0 && n < MAX_LAYERS)
+    return KEYMAP_TG(n);
+  if (sscanf(s, "OSL(%i)", &n) == 1 && n >= 0 && n < MAX_LAYERS)
+    return KEYMAP_OSL(n);
+  if (sscanf(s, "PROFILE(%i)", &n) == 1 && n >= 0 && n < MAX_PROFILES)
+    return KEYMAP_PROFILE(n);
+  if (sscanf(s, "MACRO(%i)", &n) == 1 && n >= 0 && n <= 0xff)
+    return KEYMAP_ENTRY(KC_MACRO, n);
+  if (sscanf(s, "CONSUMER(%i)", &n) == 1 && n >= 0 && n <= 0xff)
+    return KEYMAP_ENTRY(KC_CONSUMER, n);
+  if (sscanf(s, "SYSTEM(%i)", &n) == 1 && n >= 0 && n <= 0xff)
+    return KEYMAP_ENTRY(KC_SYSTEM, n);
+  if (sscanf(s, "PROTO(%i)", &n) == 1 && n >= 0 && n <= 0xff)
+    return KEYMAP_ENTRY(KC_PROTOCOL, n);
+  if (sscanf(s, "TAPHOLD(%i)", &n) == 1 && n >= 0 && n <= 0xff)
+    return KEYMAP_ENTRY(KC_TAPHOLD, n);
+
+  for (un = mouseNames; un -> name; un++)
+    {
+      if (strcmp(un -> name, s) == 0)
+        return KEYMAP_ENTRY(KC_MOUSE, un -> usage);
+    }
+
+  // names first, "1" is the key and not usage 1:
+  for (un = usageNames; un -> name; un++)
+    {
+      if (strcmp(un -> name, s) == 0)
+        return un -> usage;
+    }
+
+  if (parseNumber(s, &value) && value >= 0 && value <= 0xff)
+    return value;
+
+  return -1;
+}
+
+static int isUsage(int value)
+{
+  return (value >> 8) == KC_NORMAL;
+}
+
+static int validUsage(int value)
+{
+  if ((value >> 8) == KC_CONSUMER)
+    return (value & 0xff) >= consMin && (value & 0xff) <= consMax;
+  if (value == 0 || !isUsage(value))
+    return 1;
+  if (value >= modMin && value <= modMax)
+    return 1;
+  return value >= arrayMin && value <= arrayMax;
+}
+
+/*
+ * Descriptor parsing: the bytes of usbHidReportDescriptor are read
+ * from the C source and walked as HID short items.
+ */
+static int readDescriptor(const char *file, unsigned char *desc, int max)
+{
+  FILE *f = fopen(file, "r");
+  char line[256], *p, *end;
+  int len = 0, inside = 0;
+  long value;
+
+  if (f == 0)
+    {
+      perror(file);
+      return -1;
+    }
+
+  while (fgets(line, sizeof line, f))
+    {
+      if ((p = strstr(line, "//")) != 0)
+        *p = 0;
+
+      if (!inside)
+        {
+          if (strstr(line, "usbHidReportDescriptor") == 0 || strchr(line, '{') == 0)
+            continue;
+          inside = 1;
+          p = strchr(line, '{') + 1;
+        }
+      else
+        p = line;
+
+      for (; *p; p++)
+        {
+          if (*p == '}')
+            {
+              fclose(f);
+              return len;
+            }
+          if (!isdigit((unsigned char)*p))
+            continue;
+
+          value = strtol(p, &end, 0);
+          if (len < max)
+            desc[len++] = (unsigned char)value;
+          p = end - 1;
+        }
+    }
+
+  fclose(f);
+  fprintf(stderr, "%s: usbHidReportDescriptor not found\n", file);
+  return -1;
+}
+
+static void parseDescriptor(const unsigned char *desc, int len)
+{
+  int i = 0, size, type, tag, j;
+  long value, sval;
+  int page = 0, logMin = 0, logMax = 0, useMin = 0, useMax = 0;
+
+  while (i < len)
+    {
+      size = desc[i] & 3;
+      if (size == 3)
+        size = 4;
+      type = (desc[i] >> 2) & 3;
+      tag = desc[i] >> 4;
+
+      value = 0;
+      for (j = 0; j < size && i + 1 + j < len; j++)
+        value |= (long)desc[i + 1 + j] << (8 * j);
+
+      // logical values are signed, usages are not:
+      sval = value;
+      if (size == 1 && (value & 0x80))
+        sval -= 0x100;
+      else if (size == 2 && (value & 0x8000))
+        sval -= 0x10000;
+
+      if (type == 1 && tag == 0)
+        page = (int)value;
+      else if (type == 1 && tag == 1)
+        logMin = (int)sval;
+      else if (type == 1 && tag == 2)
+        logMax = (int)sval;
+      else if (type == 2 && tag == 1)
+        useMin = (int)value;
+      else if (type == 2 && tag == 2)
+        useMax = (int)value;
+      else if (type == 0 && tag == 8 && page == 0x0c && !(value & 3))
+        {
+          consMin = useMin > logMin ? useMin : logMin;
+          consMax = useMax < logMax ? useMax : logMax;
+        }
+      else if (type == 0 && tag == 8 && page == 7 && !(value & 1))
+        {
+          // variable: modifier bits, array: key codes
+          if (value & 2)
+            {
+              modMin = useMin;
+              modMax = useMax;
+            }
+          else
+            {
+              arrayMin = useMin > logMin ? useMin : logMin;
+              arrayMax = useMax < logMax ? useMax : logMax;
+            }
+        }
+
+      // locals are only valid for one main item:
+      if (type == 0)
+        useMin = useMax = 0;
+
+      i += 1 + size;
+    }
+}
+
+/*
+ * Keymap file parsing.
+ */
+
+// sequence line: up to SEQUENCE_KEYS keys and the value. combo keys
+// are scancodes and sorted, leader keys are usages in typed order.
+static void parseSequence(char **tok, int n, Trie *t, int isCombo)
+{
+  Sequence *q;
+  int i, j, key, value;
+
+  if (n < (isCombo ? 3 : 2) || n > SEQUENCE_KEYS + 1)
+    {
+      error(isCombo ? "combos need 2 to 3 scancodes and a value"
+            : "leader sequences need 1 to 3 usages and a value", tok[0]);
+      return;
+    }
+  if (t -> count == MAX_SEQUENCES)
+    {
+      error("too many sequences", tok[0]);
+      return;
+    }
+
+  q = &t -> seq[t -> count];
+  q -> count = 0;
+  q -> line = lineNo;
+  for (i = 0; i < n - 1; i++)
+    {
+      if (isCombo)
+        {
+          if (!parseNumber(tok[i], &key) || key < 1 || key >= SCANCODES - 1)
+            {
+              error("bad scancode", tok[i]);
+              return;
+            }
+        }
+      else
+        {
+          // plain keys only, modifiers pass through a sequence
+          key = parseValue(tok[i]);
+          if (key <= 0 || !isUsage(key) || key >= 0xe0)
+            {
+              error("leader keys must be usages", tok[i]);
+              return;
+            }
+        }
+
+      for (j = 0; j < q -> count; j++)
+        {
+          if (isCombo && q -> key[j] == key)
+            {
+              error("scancode listed twice in combo", tok[i]);
+              return;
+            }
+        }
+
+      // combos kept sorted, the firmware sorts the pressed keys the same way:
+      for (j = q -> count; isCombo && j > 0 && q -> key[j - 1] > key; j--)
+        q -> key[j] = q -> key[j - 1];
+      q -> key[j] = key;
+      q -> count++;
+    }
+
+  if ((value = parseValue(tok[n - 1])) < 0)
+    {
+      error("unknown usage", tok[n - 1]);
+      return;
+    }
+  if (!validUsage(value))
+    {
+      error("usage outside the range of usbHidReportDescriptor", tok[n - 1]);
+      return;
+    }
+  // sequences are matched after the dual-role keys are decided:
+  if ((value >> 8) == KC_TAPHOLD || value == 0)
+    {
+      error("sequences can't be empty or dual-role", tok[n - 1]);
+      return;
+    }
+
+  q -> value = value;
+  t -> count++;
+}
+
+static void parseKeymap(FILE *f)
+{
+  char line[256], *tok[4], *p;
+  int n, sc, value, layer = -1, i, profile = 0;
+  Trie *seq = 0;
+  Layout *lo = 0;
+
+  lineNo = 0;
+  while (fgets(line, sizeof line, f))
+    {
+      lineNo++;
+      if ((p = strchr(line, '#')) != 0)
+        *p = 0;
+
+      for (n = 0, p = strtok(line, " \t\r\n"); p && n < 4; p = strtok(0, " \t\r\n"))
+        tok[n++] = p;
+      if (n == 0)
+        continue;
+
+      if (strcmp(tok[0], "profile") == 0)
+        {
+          if (n < 2 || !parseNumber(tok[1], &profile) || profile < 0 || profile >= MAX_PROFILES)
+            {
+              error("bad profile number", n > 1 ? tok[1] : 0);
+              profile = 0;
+              continue;
+            }
+          if (profile >= profileCount)
+            profileCount = profile + 1;
+          snprintf(profileName[profile], sizeof profileName[profile], "%s", n > 2 ? tok[2] : "");
+          layer = -1;
+          lo = 0;
+          seq = 0;
+          continue;
+        }
+
+      if (strcmp(tok[0], "layer") == 0)
+        {
+          if (n < 2 || !parseNumber(tok[1], &layer) || layer < 0 || layer >= MAX_LAYERS)
+            {
+              error("bad layer number", n > 1 ? tok[1] : 0);
+              layer = -1;
+              continue;
+            }
+          if (layer >= layerCount)
+            layerCount = layer + 1;
+          if (profile == 0)
+            snprintf(layerName[layer], sizeof layerName[layer], "%s", n > 2 ? tok[2] : "");
+          lo = 0;
+          seq = 0;
+          continue;
+        }
+
+      if (strcmp(tok[0], "combos") == 0 || strcmp(tok[0], "leader") == 0)
+        {
+          lo = 0;
+          layer = -1;
+          seq = tok[0][0] == 'c' ? &combos : &leaders;
+          continue;
+        }
+
+      if (strcmp(tok[0], "layout") == 0)
+        {
+          if (n < 4 || layoutCount == MAX_LAYOUTS)
+            {
+              error("layout needs a name, first and last layout byte", 0);
+              continue;
+            }
+          lo = &layouts[layoutCount++];
+          snprintf(lo -> name, sizeof lo -> name, "%s", tok[1]);
+          if (!parseNumber(tok[2], &lo -> first) || !parseNumber(tok[3], &lo -> last)
+              || lo -> first > lo -> last || lo -> last > 0xff)
+            error("bad layout byte range", tok[1]);
+          layer = -1;
+          seq = 0;
+          continue;
+        }
+
+      if (seq)
+        {
+          parseSequence(tok, n, seq, seq == &combos);
+          continue;
+        }
+
+      if (n != 2)
+        {
+          error("expected scancode and value", tok[0]);
+          continue;
+        }
+      if (!parseNumber(tok[0], &sc) || sc < 0 || sc >= SCANCODES)
+        {
+          error("bad scancode", tok[0]);
+          continue;
+        }
+      if ((value = parseValue(tok[1])) < 0)
+        {
+          error("unknown usage", tok[1]);
+          continue;
+        }
+      if (!validUsage(value))
+        {
+          error("usage outside the range of usbHidReportDescriptor", tok[1]);
+          continue;
+        }
+      if (lo)
+        {
+          if (!isUsage(value))
+            error("layouts can only map to usages", tok[1]);
+          for (i = 0; i < lo -> count; i++)
+            {
+              if (lo -> scancode[i] == sc)
+                error("scancode listed twice in layout", tok[0]);
+            }
+          // kept sorted, the firmware scans the delta in order:
+          for (i = lo -> count; i > 0 && lo -> scancode[i - 1] > sc; i--)
+            {
+              lo -> scancode[i] = lo -> scancode[i - 1];
+              lo -> usage[i] = lo -> usage[i - 1];
+            }
+          lo -> scancode[i] = sc;
+          lo -> usage[i] = value;
+          lo -> count++;
+        }
+      else if (layer >= 0)
+        {
+          if (layerSet[profile][layer][sc])
+            error("scancode listed twice in layer", tok[0]);
+          layers[profile][layer][sc] = value;
+          layerSet[profile][layer][sc] = 1;
+        }
+      else
+        error("entry outside of a layer or layout", tok[0]);
+    }
+}
+
+// fill in what the profiles above 0 don't change
+static void copyProfiles()
+{
+  int p, l, sc;
+
+  for (p = 1; p < profileCount; p++)
+    for (l = 0; l < layerCount; l++)
+      for (sc = 0; sc < SCANCODES; sc++)
+        if (!layerSet[p][l][sc])
+          layers[p][l][sc] = layers[0][l][sc];
+}
+
+// an action for a missing layer or profile
+static int missingTarget(int value)
+{
+  if ((value >> 8) != KC_LAYER)
+    return 0;
+  if ((value & 0x0c) == 0x0c)
+    return (value & 3) >= profileCount;
+  return (value & 3) >= layerCount;
+}
+
+// duplicate usages and actions for missing layers are mistakes
+static void checkKeymap()
+{
+  int p, l, sc, other;
+  int (*map)[SCANCODES];
+
+  lineNo = 0;
+  for (p = 0; p < profileCount; p++)
+    {
+      map = layers[p];
+      for (l = 0; l < layerCount; l++)
+        {
+          for (sc = 0; sc < SCANCODES; sc++)
+            {
+              if (missingTarget(map[l][sc]))
+                error("layer action for a missing layer or profile", layerName[l]);
+
+              // several keys may share a macro or action, not a usage:
+              if (map[l][sc] == 0 || !isUsage(map[l][sc]))
+                continue;
+
+              for (other = sc + 1; other < SCANCODES; other++)
+                {
+                  if (map[l][other] == map[l][sc])
+                    {
+                      fprintf(stderr, "%s: profile %d layer %d: scancodes 0x%02x and 0x%02x both map to 0x%02x\n",
+                              keymapFile, p, l, sc, other, map[l][sc]);
+                      errors++;
+                    }
+                }
+            }
+        }
+    }
+
+  for (l = 0; l < combos.count; l++)
+    if (missingTarget(combos.seq[l].value))
+      error("combo action for a missing layer or profile", 0);
+  for (l = 0; l < leaders.count; l++)
+    if (missingTarget(leaders.seq[l].value))
+      error("leader action for a missing layer or profile", 0);
+}
+
+// lay the sequences out as a trie: children of a node next to each
+// other, in key order, so one level is a short linear scan.
+static int trieLevel(Trie *t, int depth, int lo, int hi)
+{
+  int first = t -> nodes, i, j, n;
+
+  // one node per distinct key at this depth, children follow later
+  for (i = lo; i < hi; i = j)
+    {
+      for (j = i; j < hi && t -> seq[j].key[depth] == t -> seq[i].key[depth]; j++)
+        ;
+      t -> node[t -> nodes].key = t -> seq[i].key[depth];
+      t -> node[t -> nodes].value = 0;
+      t -> node[t -> nodes].count = 0;
+      t -> nodes++;
+    }
+
+  for (i = lo, n = first; i < hi; i = j, n++)
+    {
+      for (j = i; j < hi && t -> seq[j].key[depth] == t -> seq[i].key[depth]; j++)
+        ;
+      // the sequence ending here sorts first
+      if (t -> seq[i].count == depth + 1)
+        t -> node[n].value = t -> seq[i++].value;
+      if (i < j)
+        {
+          t -> node[n].first = t -> nodes;
+          t -> node[n].count = trieLevel(t, depth + 1, i, j);
+        }
+      else
+        t -> node[n].first = 0;
+    }
+
+  return n - first;
+}
+
+static int compareSequences(const void *a, const void *b)
+{
+  const Sequence *x = a, *y = b;
+  int i;
+
+  for (i = 0; i < x -> count && i < y -> count; i++)
+    {
+      if (x -> key[i] != y -> key[i])
+        return x -> key[i] - y -> key[i];
+    }
+
+  return x -> count - y -> count;
+}
+
+static void buildTrie(Trie *t)
+{
+  int i;
+
+  qsort(t -> seq, t -> count, sizeof *t -> seq, compareSequences);
+  for (i = 1; i < t -> count; i++)
+    {
+      if (compareSequences(&t -> seq[i - 1], &t -> seq[i]) == 0)
+        {
+          lineNo = t -> seq[i].line;
+          error("sequence listed twice", t -> what);
+        }
+    }
+
+  if (t -> count)
+    t -> roots = trieLevel(t, 0, 0, t -> count);
+}
+
+// table entry: modifiers become their bit in the modifier byte
+static int packEntry(int value)
+{
+  if (isUsage(value) && value >= 0xe0 && value <= 0xe7)
+    return KEYMAP_ENTRY(KC_MODIFIER, 1 << (value - 0xe0));
+
+  return value;
+}
+
+// entries of profile p that differ from profile 0, written to f
+static int profileDelta(int p, FILE *f)
+{
+  int l, sc, n = 0;
+
+  for (l = 0; p > 0 && l < layerCount; l++)
+    for (sc = 0; sc < SCANCODES; sc++)
+      if (layers[p][l][sc] != layers[0][l][sc])
+        {
+          if (f)
+            fprintf(f, "  {0x%02x, %d, 0x%04x},\n", sc, l, packEntry(layers[p][l][sc]));
+          n++;
+        }
+
+  return n;
+}
+
+static void printCost()
+{
+  int l, i, sc, total = 0, unmapped = 0;
+
+  fprintf(stderr, "usages 0x%02x-0x%02x, modifiers 0x%02x-0x%02x, consumer 0x%02x-0x%02x\n",
+          arrayMin, arrayMax, modMin, modMax, consMin, consMax);
+
+  fprintf(stderr, "unmapped scancodes:");
+  for (sc = 1; sc < SCANCODES - 1; sc++)
+    {
+      if (layers[0][0][sc] == 0)
+        {
+          fprintf(stderr, " 0x%02x", sc);
+          unmapped++;
+        }
+    }
+  fprintf(stderr, unmapped ? "\n" : " none\n");
+
+  fprintf(stderr, "profile 0 %s\n", profileName[0]);
+  for (l = 0; l < layerCount; l++)
+    {
+      fprintf(stderr, "layer %d %-10s %4d bytes\n", l, layerName[l], 2 * SCANCODES);
+      total += 2 * SCANCODES;
+    }
+  for (i = 1; i < profileCount; i++)
+    {
+      fprintf(stderr, "profile %d %-8s %4d bytes, %d entries\n", i, profileName[i],
+              4 * profileDelta(i, 0) + 4, profileDelta(i, 0));
+      total += 4 * profileDelta(i, 0) + 4;
+    }
+  // profile 0 terminator and the pointer list
+  total += 4 + 2 * profileCount;
+  for (i = 0; i < layoutCount; i++)
+    {
+      fprintf(stderr, "layout %-9s %4d bytes\n", layouts[i].name, 2 * layouts[i].count + 1 + 4);
+      total += 2 * layouts[i].count + 1 + 4;
+    }
+  if (combos.count)
+    {
+      fprintf(stderr, "combos %-9d %4d bytes\n", combos.count, 5 * combos.nodes + SCANCODES / 8);
+      total += 5 * combos.nodes + SCANCODES / 8;
+    }
+  if (leaders.count)
+    {
+      fprintf(stderr, "leader %-9d %4d bytes\n", leaders.count, 5 * leaders.nodes);
+      total += 5 * leaders.nodes;
+    }
+  fprintf(stderr, "flash total      %4d bytes\n", total);
+}
+
+static void writeTrie(FILE *f, const Trie *t, const char *roots, const char *name)
+{
+  int i;
+
+  fprintf(f, "// top level 0 .. %s - 1: {key, first child, children, entry}\n", roots);
+  fprintf(f, "#define %s  %d\n\n", roots, t -> roots);
+  fprintf(f, "PROGMEM const SequenceNode %s[] = {\n", name);
+  for (i = 0; i < t -> nodes; i++)
+    fprintf(f, "  {0x%02x, %3d, %d, 0x%04x},\n", t -> node[i].key, t -> node[i].first,
+            t -> node[i].count, packEntry(t -> node[i].value));
+  if (t -> nodes == 0)
+    fprintf(f, "  {0x00, 0, 0, 0x0000},\n");
+  fprintf(f, "};\n");
+}
+
+// layers at the top holding only mouse keys and layer actions, in
+// all profiles. they are left out of a build without WITH_MOUSE, a
+// toggle to them does nothing there.
+static int mouseLayers()
+{
+  int p, l, sc, cls;
+
+  for (l = layerCount - 1; l > 0; l--)
+    for (p = 0; p < profileCount; p++)
+      for (sc = 0; sc < SCANCODES; sc++)
+        {
+          cls = layers[p][l][sc] >> 8;
+          if (layers[p][l][sc] && cls != KC_MOUSE && cls != KC_LAYER)
+            return layerCount - 1 - l;
+        }
+
+  return layerCount - 1;
+}
+
+static void writeTables(FILE *f)
+{
+  int p, l, sc, i;
+  int mouse = mouseLayers();
+
+  fprintf(f, "/*\n * Generated by tools/keymapc from %s, do not edit.\n */\n\n", keymapFile);
+  fprintf(f, "#define KEYMAP_PROFILES  %d\n", profileCount);
+  if (mouse)
+    fprintf(f, "#ifdef WITH_MOUSE\n#define KEYMAP_LAYERS    %d\n#else\n"
+            "#define KEYMAP_LAYERS    %d   // without the mouse key layers\n#endif\n\n",
+            layerCount, layerCount - mouse);
+  else
+    fprintf(f, "#define KEYMAP_LAYERS    %d\n\n", layerCount);
+
+  fprintf(f, "// entries: class << 8 | value, see keymap.h\n");
+  fprintf(f, "// profile 0 %s\n", profileName[0]);
+  fprintf(f, "PROGMEM const uint16_t sunkeycodes[KEYMAP_LAYERS][128] = {\n");
+  for (l = 0; l < layerCount; l++)
+    {
+      if (mouse && l == layerCount - mouse)
+        fprintf(f, "#ifdef WITH_MOUSE\n");
+      fprintf(f, "/* layer %d %s */\n{\n", l, layerName[l]);
+      for (sc = 0; sc < SCANCODES; sc++)
+        {
+          if (sc % 8 == 0)
+            fprintf(f, "  ");
+          fprintf(f, "0x%04x%s", packEntry(layers[0][l][sc]), sc == SCANCODES - 1 ? " " : ", ");
+          if (sc % 8 == 7)
+            fprintf(f, "\t/* 0x%02x-0x%02x */\n", sc - 7, sc);
+        }
+      fprintf(f, "}%s\n", l == layerCount - 1 && !mouse ? "" : ",");
+    }
+  if (mouse)
+    fprintf(f, "#endif\n");
+  fprintf(f, "};\n\n");
+
+  // the tables of features left out of the build aren't linked
+  fprintf(f, "#ifdef WITH_PROFILES\n");
+  fprintf(f, "// profile deltas against profile 0: {scancode, layer, entry}\n");
+  fprintf(f, "// 0xff terminated.\n");
+  for (p = 0; p < profileCount; p++)
+    {
+      fprintf(f, "PROGMEM const KeymapDelta profile%d[] = {\t/* %s */\n", p, profileName[p]);
+      profileDelta(p, f);
+      fprintf(f, "  {0xff, 0, 0x0000}\n};\n\n");
+    }
+
+  fprintf(f, "PROGMEM const KeymapDelta * const keymapProfiles[KEYMAP_PROFILES] = {\n");
+  for (p = 0; p < profileCount; p++)
+    fprintf(f, "  profile%d,\n", p);
+  fprintf(f, "};\n#endif\n\n");
+
+  fprintf(f, "// layout deltas against layer 0: {scancode, usage} pairs\n");
+  fprintf(f, "// sorted by scancode, 0xff terminated.\n");
+  for (i = 0; i < layoutCount; i++)
+    {
+      fprintf(f, "PROGMEM const uint8_t layout%s[] = {\n", layouts[i].name);
+      for (sc = 0; sc < layouts[i].count; sc++)
+        fprintf(f, "  0x%02x, 0x%02x,\n", layouts[i].scancode[sc], layouts[i].usage[sc]);
+      fprintf(f, "  0xff\n};\n\n");
+    }
+
+  fprintf(f, "// layout byte ranges, anything else uses layer 0 unchanged\n");
+  fprintf(f, "PROGMEM const KeymapLayout keymapLayouts[] = {\n");
+  for (i = 0; i < layoutCount; i++)
+    fprintf(f, "  {0x%02x, 0x%02x, layout%s},\n", layouts[i].first, layouts[i].last, layouts[i].name);
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "#ifdef WITH_COMBO\n");
+  fprintf(f, "// scancodes that are part of a combo\n");
+  fprintf(f, "PROGMEM const uint8_t comboKeys[%d] = {\n ", SCANCODES / 8);
+  for (i = 0; i < SCANCODES / 8; i++)
+    {
+      int bits = 0, c, k;
+
+      for (c = 0; c < combos.count; c++)
+        for (k = 0; k < combos.seq[c].count; k++)
+          if (combos.seq[c].key[k] >> 3 == i)
+            bits |= 1 << (combos.seq[c].key[k] & 7);
+      fprintf(f, " 0x%02x,", bits);
+    }
+  fprintf(f, "\n};\n\n");
+
+  fprintf(f, "// combo trie over the sorted scancodes\n");
+  writeTrie(f, &combos, "COMBO_ROOTS", "comboTrie");
+  fprintf(f, "#endif\n\n#ifdef WITH_LEADER\n");
+  fprintf(f, "// leader sequence trie over the usages typed after the leader\n");
+  writeTrie(f, &leaders, "LEADER_ROOTS", "leaderTrie");
+  fprintf(f, "#endif\n");
+}
+
+int main(int argc, char **argv)
+{
+  unsigned char desc[512];
+  int len;
+  FILE *f;
+
+  if (argc != 4)
+    {
+      fprintf(stderr, "usage: %s KEYMAP DESCRIPTOR OUTPUT\n", argv[0]);
+      return 2;
+    }
+
+  keymapFile = argv[1];
+
+  if ((len = readDescriptor(argv[2], desc, sizeof desc)) < 0)
+    return 1;
+  parseDescriptor(desc, len);
+  if (arrayMin < 0 || modMin < 0)
+    {
+      fprintf(stderr, "%s: no keyboard inputs in usbHidReportDescriptor\n", argv[2]);
+      return 1;
+    }
+
+  if ((f = fopen(keymapFile, "r")) == 0)
+    {
+      perror(keymapFile);
+      return 1;
+    }
+  parseKeymap(f);
+  fclose(f);
+
+  if (layerCount == 0)
+    error("no layers", 0);
+  copyProfiles();
+  checkKeymap();
+  buildTrie(&combos);
+  buildTrie(&leaders);
+
+  if (errors)
+    {
+      fprintf(stderr, "%s: %d error(s), %s not written\n", keymapFile, errors, argv[3]);
+      return 1;
+    }
+
+  printCost();
+
+  if ((f = fopen(argv[3], "w")) == 0)
+    {
+      perror(argv[3]);
+      return 1;
+    }
+  writeTables(f);
+  fclose(f);
+
+  return 0;
+}
@@ -0,0 +1,484 @@
+/*
+ * replay - run a recorded Sun keyboard capture through the translation
+ * core and print the reports the host would see.
+ *
+ *   replay [-i MS] [-n PASSES] [-g GOLDEN] [-o OUT] CAPTURE
+ *
+ * CAPTURE is text, one line per byte from the keyboard: the time in
+ * ms and the byte in hex, more bytes on a line arrive at once. # starts
+ * a comment.
+ *
+ *   1700 4d      # a down
+ *   1760 cd      # a up
+ *
+ * The core runs like the main loop does, once per ms. The host polls
+ * the interrupt endpoints every -i ms (bInterval, 10 by default), a
+ * new report is only made once the last one was taken. Every report
+ * taken is printed on stdout, or to OUT: the time, the endpoint and
+ * the bytes, endpoint 1 carries keyboard and consumer reports, 3 the
+ * mouse.
+ *
+ * With -g the reports are compared with a GOLDEN file of the same
+ * form, edge by edge: a key, modifier, consumer usage or mouse button
+ * going down or up. Edges missing or out of order are printed, so are
+ * edges the golden file doesn't have, and the exit status is 1. The
+ * times may differ.
+ *
+ * On stderr go the events processed per second, an event being a
+ * translateStep() that changed the report, and the worst and mean
+ * cost of one, on the build host. Only the time spent in the core
+ * counts. The capture is run -n times for those, 20 by default.
+ *
+ * Builds with the host compiler against the same stand-ins as the
+ * tests, see the Makefile.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../sun_defs.h"
+#include "../keymap.h"
+#include "../remap.h"
+#include "../turbo.h"
+#include "../consumer.h"
+#include "../mouse.h"
+#include "../translate.h"
+#include "../test/host/host.h"
+
+// after the last byte, for taps, timeouts and macros to run out
+#define SETTLE_MS  3000
+
+#define MAX_BYTES    65536
+#define MAX_REPORTS  16384
+#define MAX_EDGES    (MAX_REPORTS * 4)
+#define MAX_REPORT   KEYBOARD_REPORT_SIZE
+
+typedef struct
+{
+  unsigned long ms;
+  uint8_t byte;
+} CaptureByte;
+
+typedef struct
+{
+  unsigned long ms;
+  uint8_t ep;
+  uint8_t len;
+  uint8_t data[MAX_REPORT];
+} Report;
+
+// k key usage, m modifier bit, c consumer usage, b mouse button
+typedef struct
+{
+  unsigned long ms;
+  char kind;
+  uint16_t code;
+  uint8_t up;
+  uint8_t used;
+} Edge;
+
+static CaptureByte capture[MAX_BYTES];
+static unsigned captureCount;
+
+static Report reports[MAX_REPORTS];
+static Report golden[MAX_REPORTS];
+static unsigned reportCount, goldenCount;
+
+static Edge outEdges[MAX_EDGES];
+static Edge goldenEdges[MAX_EDGES];
+
+// core timing, ns
+static unsigned long long coreTime, stepMax, stepTime;
+static unsigned long steps, bytesIn;
+
+static unsigned long long nsNow()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the next line with something on it, comment stripped
+static char *nextLine(FILE *f, char *line, int size, unsigned *n)
+{
+  char *p;
+
+  while (fgets(line, size, f) != NULL)
+    {
+      (*n)++;
+      if ((p = strchr(line, '#')) != NULL)
+        *p = 0;
+      for (p = line; *p == ' ' || *p == '\t'; p++)
+        ;
+      if (*p && *p != '\n' && *p != '\r')
+        return p;
+    }
+
+  return NULL;
+}
+
+static int readCapture(const char *name)
+{
+  char line[256], *p, *end;
+  unsigned long ms, last = 0, b;
+  unsigned n = 0;
+  FILE *f;
+
+  if ((f = fopen(name, "r")) == NULL)
+    {
+      perror(name);
+      return -1;
+    }
+
+  while ((p = nextLine(f, line, sizeof line, &n)) != NULL)
+    {
+      ms = strtoul(p, &end, 10);
+      if (end == p || ms < last)
+        {
+          fprintf(stderr, "%s:%u: time missing or going back\n", name, n);
+          return -1;
+        }
+      last = ms;
+
+      for (p = end; ; p = end)
+        {
+          b = strtoul(p, &end, 16);
+          if (end == p)
+            break;
+          if (b > 0xff || captureCount == MAX_BYTES)
+            {
+              fprintf(stderr, "%s:%u: bad byte or too many\n", name, n);
+              return -1;
+            }
+          capture[captureCount].ms = ms;
+          capture[captureCount++].byte = b;
+        }
+    }
+
+  fclose(f);
+  return 0;
+}
+
+static int readReports(const char *name, Report *r, unsigned *count)
+{
+  char line[256], *p, *end;
+  unsigned n = 0;
+  unsigned long v;
+  FILE *f;
+
+  if ((f = fopen(name, "r")) == NULL)
+    {
+      perror(name);
+      return -1;
+    }
+
+  while ((p = nextLine(f, line, sizeof line, &n)) != NULL)
+    {
+      if (*count == MAX_REPORTS)
+        {
+          fprintf(stderr, "%s:%u: too many reports\n", name, n);
+          return -1;
+        }
+
+      r -> ms = strtoul(p, &end, 10);
+      r -> ep = strtoul(end, &end, 10);
+      for (r -> len = 0, p = end; r -> len < MAX_REPORT; p = end)
+        {
+          v = strtoul(p, &end, 16);
+          if (end == p)
+            break;
+          r -> data[r -> len++] = v;
+        }
+
+      if (r -> ep != 1 && r -> ep != 3)
+        {
+          fprintf(stderr, "%s:%u: endpoint 1 or 3 expected\n", name, n);
+          return -1;
+        }
+      r++;
+      (*count)++;
+    }
+
+  fclose(f);
+  return 0;
+}
+
+static void addReport(unsigned long ms, uint8_t ep, const uint8_t *data, uint8_t len)
+{
+  Report *r = &reports[reportCount];
+
+  if (reportCount == MAX_REPORTS)
+    return;
+
+  r -> ms = ms;
+  r -> ep = ep;
+  r -> len = len;
+  memcpy(r -> data, data, len);
+  reportCount++;
+}
+
+// one pass over the capture, reports are kept if record is set.
+// The clock goes on from the pass before, base is where it is.
+static void run(unsigned interval, int record, unsigned long base)
+{
+  uint8_t ep1[MAX_REPORT], ep3[MOUSE_REPORT_SIZE];
+  uint8_t ep1Len = 0, ep3Full = 0, changed;
+  unsigned long ms, end;
+  unsigned long long t, dt;
+  unsigned next = 0;
+
+  ms = captureCount ? capture[0].ms : 0;
+  end = (captureCount ? capture[captureCount - 1].ms : 0) + SETTLE_MS;
+
+  for (; ms <= end; ms++)
+    {
+      hostNow = base + ms;
+
+      t = nsNow();
+      while (next < captureCount && capture[next].ms <= ms)
+        {
+          translateByte(capture[next++].byte, hostNow);
+          bytesIn++;
+        }
+      translatePoll(hostNow);
+      coreTime += nsNow() - t;
+
+      turboPoll(hostNow);
+      consumerPoll(hostNow);
+      mousePoll(hostNow);
+
+      // the host takes what is waiting
+      if (ms % interval == 0)
+        {
+          if (ep1Len && record)
+            addReport(ms, 1, ep1, ep1Len);
+          if (ep3Full && record)
+            addReport(ms, 3, ep3, sizeof ep3);
+          ep1Len = ep3Full = 0;
+        }
+
+      if (!ep3Full && mouseReport(ep3))
+        ep3Full = 1;
+
+      if (ep1Len)
+        continue;
+
+      t = nsNow();
+      changed = translateStep(hostNow);
+      dt = nsNow() - t;
+      coreTime += dt;
+
+      if (changed)
+        {
+          steps++;
+          stepTime += dt;
+          if (dt > stepMax)
+            stepMax = dt;
+
+          translateReport(ep1);
+          ep1Len = KEYBOARD_REPORT_SIZE;
+        }
+      else if (consumerReport(ep1))
+        ep1Len = 3;
+    }
+}
+
+static void printReports(FILE *f)
+{
+  unsigned i, j;
+
+  for (i = 0; i < reportCount; i++)
+    {
+      fprintf(f, "%7lu %u ", reports[i].ms, reports[i].ep);
+      for (j = 0; j < reports[i].len; j++)
+        fprintf(f, " %02x", reports[i].data[j]);
+      fprintf(f, "\n");
+    }
+}
+
+static unsigned addEdge(Edge *e, unsigned n, unsigned long ms, char kind, uint16_t code, uint8_t up)
+{
+  if (n == MAX_EDGES)
+    return n;
+
+  e[n].ms = ms;
+  e[n].kind = kind;
+  e[n].code = code;
+  e[n].up = up;
+  e[n].used = 0;
+  return n + 1;
+}
+
+static int has(const uint8_t *keys, uint8_t usage)
+{
+  uint8_t i;
+
+  for (i = 0; i < 6; i++)
+    if (keys[i] == usage)
+      return 1;
+
+  return 0;
+}
+
+// the reports as edges against the one before, releases first
+static unsigned edges(const Report *r, unsigned count, Edge *e)
+{
+  uint8_t kbd[KEYBOARD_REPORT_SIZE] = {REPORT_ID_KEYBOARD}, buttons = 0;
+  uint16_t usage = 0, u;
+  unsigned i, n = 0;
+  uint8_t k;
+
+  for (; count--; r++)
+    {
+      if (r -> ep == 3 && r -> len >= 1)
+        {
+          for (k = 0; k < 8; k++)
+            if ((buttons ^ r -> data[0]) & (1 << k))
+              n = addEdge(e, n, r -> ms, 'b', k, !(r -> data[0] & (1 << k)));
+          buttons = r -> data[0];
+        }
+      else if (r -> len >= 3 && r -> data[0] == REPORT_ID_CONSUMER)
+        {
+          u = r -> data[1] | r -> data[2] << 8;
+          if (usage && u != usage)
+            n = addEdge(e, n, r -> ms, 'c', usage, 1);
+          if (u && u != usage)
+            n = addEdge(e, n, r -> ms, 'c', u, 0);
+          usage = u;
+        }
+      else if (r -> len == KEYBOARD_REPORT_SIZE && r -> data[0] == REPORT_ID_KEYBOARD)
+        {
+          for (k = 0; k < 8; k++)
+            if ((kbd[1] & ~r -> data[1]) & (1 << k))
+              n = addEdge(e, n, r -> ms, 'm', k, 1);
+          for (i = 2; i < KEYBOARD_REPORT_SIZE; i++)
+            if (kbd[i] && !has(r -> data + 2, kbd[i]))
+              n = addEdge(e, n, r -> ms, 'k', kbd[i], 1);
+          for (k = 0; k < 8; k++)
+            if ((~kbd[1] & r -> data[1]) & (1 << k))
+              n = addEdge(e, n, r -> ms, 'm', k, 0);
+          for (i = 2; i < KEYBOARD_REPORT_SIZE; i++)
+            if (r -> data[i] && !has(kbd + 2, r -> data[i]))
+              n = addEdge(e, n, r -> ms, 'k', r -> data[i], 0);
+          memcpy(kbd, r -> data, sizeof kbd);
+        }
+    }
+
+  return n;
+}
+
+static void printEdge(const char *what, const Edge *e)
+{
+  printf("%-9s %c%c%02x at %lu ms\n", what, e -> up ? '-' : '+', e -> kind, e -> code, e -> ms);
+}
+
+// golden edges in order, each matched with the first one of the
+// output that is still free
+static int diff()
+{
+  unsigned outCount, goldenEdgeCount, i, j;
+  int last = -1, bad = 0;
+
+  outCount = edges(reports, reportCount, outEdges);
+  goldenEdgeCount = edges(golden, goldenCount, goldenEdges);
+
+  for (i = 0; i < goldenEdgeCount; i++)
+    {
+      for (j = 0; j < outCount; j++)
+        if (!outEdges[j].used && outEdges[j].kind == goldenEdges[i].kind
+            && outEdges[j].code == goldenEdges[i].code && outEdges[j].up == goldenEdges[i].up)
+          break;
+
+      if (j == outCount)
+        {
+          printEdge("lost", &goldenEdges[i]);
+          bad = 1;
+          continue;
+        }
+
+      outEdges[j].used = 1;
+      if ((int)j < last)
+        {
+          printEdge("reordered", &outEdges[j]);
+          bad = 1;
+        }
+      else
+        last = j;
+    }
+
+  for (j = 0; j < outCount; j++)
+    if (!outEdges[j].used)
+      {
+        printEdge("extra", &outEdges[j]);
+        bad = 1;
+      }
+
+  printf("%u edges, golden %u: %s\n", outCount, goldenEdgeCount, bad ? "differ" : "same");
+  return bad;
+}
+
+int main(int argc, char **argv)
+{
+  const char *goldenName = NULL, *outName = NULL;
+  unsigned interval = 10, passes = 20, i;
+  unsigned long span;
+  FILE *f;
+  int c;
+
+  while ((c = getopt(argc, argv, "i:n:g:o:")) != -1)
+    {
+      if (c == 'i')
+        interval = strtoul(optarg, NULL, 0);
+      else if (c == 'n')
+        passes = strtoul(optarg, NULL, 0);
+      else if (c == 'g')
+        goldenName = optarg;
+      else if (c == 'o')
+        outName = optarg;
+      else
+        optind = argc;
+    }
+
+  if (optind != argc - 1 || interval == 0 || passes == 0)
+    {
+      fprintf(stderr, "usage: %s [-i MS] [-n PASSES] [-g GOLDEN] [-o OUT] CAPTURE\n", argv[0]);
+      return 2;
+    }
+
+  if (readCapture(argv[optind]) < 0)
+    return 2;
+  if (goldenName != NULL && readReports(goldenName, golden, &goldenCount) < 0)
+    return 2;
+
+  remapInit();
+  keymapInit();
+
+  span = captureCount ? capture[captureCount - 1].ms - capture[0].ms + SETTLE_MS : SETTLE_MS;
+
+  for (i = 0; i < passes; i++)
+    run(interval, i == 0, i * (span + 1));
+
+  fprintf(stderr, "%u passes: %lu bytes, %lu events, %llu us in the core\n",
+          passes, bytesIn, steps, coreTime / 1000);
+  if (coreTime && steps)
+    fprintf(stderr, "%.0f events/s, translateStep() worst %llu ns, mean %llu ns\n",
+            steps * 1e9 / coreTime, stepMax, stepTime / steps);
+
+  if (outName != NULL)
+    {
+      if ((f = fopen(outName, "w")) == NULL)
+        {
+          perror(outName);
+          return 2;
+        }
+      printReports(f);
+      fclose(f);
+    }
+  else if (goldenName == NULL)
+    printReports(stdout);
+
+  return goldenName != NULL ? diff() : 0;
+}
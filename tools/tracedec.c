@@ -0,0 +1,104 @@
+/*
+ * tracedec - print the trace ring read with VREQ_TRACE_GET.
+ *
+ *   tracedec DUMP [WRITTEN]
+ *
+ * DUMP is the raw reply of the vendor request, the written count
+ * followed by the ring (see trace.h). The records are printed oldest
+ * first. WRITTEN is the count of an earlier read, only the records
+ * added since are printed then and the ones already overwritten
+ * are reported as lost.
+ *
+ * Builds with the host compiler, see the Makefile.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../trace.h"
+
+#define RECORD_SIZE  5
+#define DUMP_SIZE    (2 + TRACE_SIZE * RECORD_SIZE)
+
+static const char *names[] = {
+  "?", "boot", "rx", "report", "led", "drop", "layout", "profile"
+};
+
+static void print(unsigned n, const unsigned char *r)
+{
+  unsigned time = r[0] | r[1] << 8;
+  unsigned id = r[2], a = r[3], b = r[4];
+
+  printf("%5u %5u.%03u  ", n, time / 1000, time % 1000);
+  if (id >= sizeof names / sizeof *names)
+    id = 0;
+
+  switch (id)
+    {
+    case TRACE_BOOT:
+      printf("boot       flags %02x%s%s%s%s\n", a,
+             a & 0x01 ? " power-on" : "", a & 0x02 ? " external" : "",
+             a & 0x04 ? " brown-out" : "", a & 0x08 ? " watchdog" : "");
+      break;
+
+    case TRACE_RX:
+      printf("rx         %02x %s %02x\n", a, a & 0x80 ? "up  " : "down", a & 0x7f);
+      break;
+
+    case TRACE_REPORT:
+      printf("report     id %u  %02x\n", a, b);
+      break;
+
+    case TRACE_DROP:
+      printf("drop       event %02x%02x\n", b, a);
+      break;
+
+    default:
+      printf("%-10s %02x %02x\n", names[id], a, b);
+      break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned char dump[DUMP_SIZE];
+  unsigned written, first, n;
+  FILE *f;
+
+  if (argc < 2 || argc > 3)
+    {
+      fprintf(stderr, "usage: %s DUMP [WRITTEN]\n", argv[0]);
+      return 2;
+    }
+
+  f = fopen(argv[1], "rb");
+  if (f == NULL)
+    {
+      perror(argv[1]);
+      return 1;
+    }
+  if (fread(dump, 1, sizeof dump, f) != sizeof dump)
+    {
+      fprintf(stderr, "%s: short dump, %d bytes expected\n", argv[1], DUMP_SIZE);
+      return 1;
+    }
+  fclose(f);
+
+  // the count wraps at 16 bits, a multiple of the ring size
+  written = dump[0] | dump[1] << 8;
+  first = (written - (written < TRACE_SIZE ? written : TRACE_SIZE)) & 0xffff;
+
+  if (argc == 3)
+    {
+      n = strtoul(argv[2], NULL, 0) & 0xffff;
+      if (((written - n) & 0xffff) > TRACE_SIZE)
+        printf("%u records lost\n", ((first - n) & 0xffff));
+      else
+        first = n;
+    }
+
+  for (n = first; n != written; n = (n + 1) & 0xffff)
+    print(n, dump + 2 + (n % TRACE_SIZE) * RECORD_SIZE);
+
+  printf("written %u\n", written);
+  return 0;
+}
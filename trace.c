@@ -0,0 +1,29 @@
+/*
+ * Trace ring of fixed size binary records.
+ *
+ * Only the slot is taken with interrupts off, the record is filled in
+ * afterwards, so any context can add one in a few cycles and the USB
+ * interrupt never waits for it. The host reads the whole ring with a
+ * vendor request and tools/tracedec prints it.
+ */
+#include <util/atomic.h>
+
+#include "timer.h"
+#include "trace.h"
+
+Trace trace;
+
+void traceAdd(uint8_t id, uint8_t a, uint8_t b)
+{
+  TraceRecord *r;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      r = &trace.ring[trace.written++ & (TRACE_SIZE - 1)];
+    }
+
+  r -> time = timerNow();
+  r -> id = id;
+  r -> a = a;
+  r -> b = b;
+}
@@ -0,0 +1,39 @@
+#ifndef TRACE_HEADER_H
+# define TRACE_HEADER_H
+
+#include <stdint.h>
+
+// records kept, a power of two
+#define TRACE_SIZE  8
+
+// record ids and their payload, decoded by tools/tracedec
+#define TRACE_BOOT     1   // a: reset flags
+#define TRACE_RX       2   // a: byte from the keyboard
+#define TRACE_REPORT   3   // a: report id, b: first key or usage low byte
+#define TRACE_LED      4   // a: LED byte sent to the keyboard
+#define TRACE_DROP     5   // a: event dropped from a full queue, low byte
+#define TRACE_LAYOUT   6   // a: layout byte
+#define TRACE_PROFILE  7   // a: profile switched to
+
+// 5 bytes, no padding on the AVR
+typedef struct
+{
+  uint16_t time;   // ms, timerNow()
+  uint8_t id;
+  uint8_t a;
+  uint8_t b;
+} TraceRecord;
+
+// read as a whole by VREQ_TRACE_GET. record n of all written is
+// ring[n % TRACE_SIZE], the newest TRACE_SIZE are kept.
+typedef struct
+{
+  uint16_t written;
+  TraceRecord ring[TRACE_SIZE];
+} Trace;
+
+extern Trace trace;
+
+void traceAdd(uint8_t id, uint8_t a, uint8_t b);
+
+#endif
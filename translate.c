@@ -0,0 +1,379 @@
+/*
+ * Sun bytes to the keyboard report.
+ *
+ * Everything between the receive buffer and the USB driver that
+ * doesn't touch the hardware: the byte stream, the event stages, the
+ * keymap lookup and the key handlers keeping the report. main.c
+ * feeds the bytes and sends the reports, the tests in test/ drive
+ * the same code on the build host.
+ */
+#include <avr/pgmspace.h>
+
+#include "sun_defs.h"
+#include "keymap.h"
+#include "remap.h"
+#include "led.h"
+#include "macro.h"
+#include "events.h"
+#include "taphold.h"
+#include "combo.h"
+#include "leader.h"
+#include "turbo.h"
+#include "consumer.h"
+#include "mouse.h"
+#include "counters.h"
+#include "trace.h"
+#include "translate.h"
+
+// live key state, only changed by key events
+static uint8_t report[KEYBOARD_REPORT_SIZE] = {REPORT_ID_KEYBOARD};
+
+// Sun keys pressed and dispatched, one bit per scancode
+static uint8_t keyDown[128 / 8];
+
+// the report changed outside of an event: a remap or layout change
+// with keys held
+static uint8_t rekeyed = 0;
+
+/*
+ * Key handlers, one per keymap entry class.
+ * return 1 if the report changed.
+ */
+
+// normal keys:
+static uchar keyNormal(uchar usbKey, uchar keyUp)
+{
+  uchar cnt;
+
+  if (keyUp) 
+    {
+      for (cnt = 2; cnt < sizeof report; cnt++)
+        {
+          if (report[cnt] == usbKey)
+            {
+              report[cnt] = 0;
+              break;
+            }
+        }
+    }
+  else 
+    {
+      for (cnt = 2; cnt < sizeof report; cnt++)
+        {
+          if (report[cnt] == 0)
+            {
+              report[cnt] = usbKey;
+              break;
+            }
+        }
+    }
+
+  // key was pressed
+  return 1;
+}
+
+// modifiers, the entry holds the bit already:
+static uchar keyModifier(uchar mask, uchar keyUp)
+{
+  if (keyUp)
+    report[1] &= ~mask;
+  else 
+    report[1] |= mask;
+
+  return 1;
+}
+
+// left side rows of special function keys:
+// the macro is played back from the main loop.
+static uchar keyMacro(uchar n, uchar keyUp)
+{
+  if (!keyUp)
+    {
+      macroStart(macroGet(n));
+      ledStart(LED_MACRO, ledBlink);
+    }
+
+  return 0;
+}
+
+static uchar keyDispatch(uint16_t entry, uchar keyUp);
+
+// volume and friends go to the consumer report, which is
+// sent on its own: the keyboard report doesn't change.
+static uchar keyConsumer(uchar usage, uchar keyUp)
+{
+  if (keyUp)
+    consumerRelease(usage);
+  else
+    consumerPress(usage);
+
+  return 0;
+}
+
+// mouse keys go to the mouse interface
+static uchar keyMouse(uchar code, uchar keyUp)
+{
+  mouseKey(code, keyUp);
+  return 0;
+}
+
+// no system control report yet
+static uchar keyIgnore(uchar value, uchar keyUp)
+{
+  return 0;
+}
+
+// entries that are kept in the report while the key is held
+static uchar heldInReport(uint16_t entry)
+{
+  uchar cls = entry >> 8;
+
+  return cls == KC_NORMAL || cls == KC_MODIFIER || cls == KC_TAPHOLD;
+}
+
+// held keys are released as they were pressed before the keymap
+// changes under them and pressed again on the new tables after it,
+// so nothing sticks and nothing drops. returns 1 if one was in
+// the report. both ways look the key up on the layer it was pressed
+// on, like its release will: no press is recorded again and an armed
+// one-shot layer stays armed.
+static uchar heldKeys(uchar keyUp)
+{
+  uchar sc, changed = 0;
+  uint16_t entry;
+
+  for (sc = 0; sc < 128; sc++)
+    {
+      if (!(keyDown[sc >> 3] & (1 << (sc & 7))))
+        continue;
+
+      entry = keymapRelease(sc);
+      if (heldInReport(entry))
+        changed |= keyDispatch(entry, keyUp);
+    }
+
+  return changed;
+}
+
+#ifdef WITH_PROFILES
+// switch the profile
+static uchar keyProfile(uchar n)
+{
+  if (n == keymapProfileActive())
+    return 0;
+
+  heldKeys(1);
+  keymapProfile(n);
+  heldKeys(0);
+  traceAdd(TRACE_PROFILE, n, 0);
+
+  return 1;
+}
+#endif
+
+// layer switching keys don't go to the report:
+static uchar keyLayer(uchar code, uchar keyUp)
+{
+#ifdef WITH_PROFILES
+  if ((code & 0x0c) == 0x0c)
+    return keyUp ? 0 : keyProfile(code & 3);
+#endif
+
+  keymapAction(code, keyUp);
+  return 0;
+}
+
+// command for the keyboard
+static uchar keyProtocol(uchar cmd, uchar keyUp)
+{
+  if (!keyUp)
+    keyboardSend(cmd);
+
+  return 0;
+}
+
+// dual-role key the resolver didn't see, e.g. a second one
+// while another is held: it is its tap entry.
+static uchar keyTapHold(uchar n, uchar keyUp)
+{
+  return keyDispatch(tapholdEntry(n, 0), keyUp);
+}
+
+typedef uchar (*KeyHandler)(uchar value, uchar keyUp);
+
+static const KeyHandler keyHandlers[KC_CLASSES] PROGMEM = {
+  keyNormal,      // KC_NORMAL
+  keyModifier,    // KC_MODIFIER
+  keyMacro,       // KC_MACRO
+  keyConsumer,    // KC_CONSUMER
+  keyIgnore,      // KC_SYSTEM
+  keyLayer,       // KC_LAYER
+  keyProtocol,    // KC_PROTOCOL
+  keyTapHold,     // KC_TAPHOLD
+  keyMouse,       // KC_MOUSE
+};
+
+static uchar keyDispatch(uint16_t entry, uchar keyUp)
+{
+  uchar cls;
+  KeyHandler handler;
+
+  if(entry == 0)
+    return 0;
+
+  // the class picks the handler:
+  cls = entry >> 8;
+  if (cls >= KC_CLASSES)
+    return 0;
+
+  handler = (KeyHandler)pgm_read_ptr(&keyHandlers[cls]);
+  return handler(entry & 0xff, keyUp);
+}
+
+// build USB report buffer from a queued event -
+// based on the layers in keycodes.h
+static uchar buildUsbReport(uint16_t ev, uint16_t now)
+{
+  static uchar lastPress = 0;
+  uchar rb = ev & 0xff;
+  uint16_t entry, held;
+
+  if (ev & EVENT_ENTRY)
+    {
+      if ((ev & EVENT_TURBO) && !turboSent())
+        return 0;
+      return keyDispatch(ev & ~(EVENT_ENTRY | EVENT_UP | EVENT_TURBO), (ev & EVENT_UP) != 0);
+    }
+
+  // 0: key down, key up otherwise
+  if (rb & 0x80)
+    {
+      // leader key released with nothing pressed in between
+      if (rb == (LEADER_KEY | 0x80) && lastPress == LEADER_KEY)
+        leaderStart(now);
+      keyDown[(rb & 0x7f) >> 3] &= ~(1 << (rb & 7));
+      if (turboRelease(rb & 0x7f))
+        return 0;
+      return keyDispatch(keymapRelease(rb & 0x7f), 1);
+    }
+
+  lastPress = rb;
+  entry = keymapPress(rb);
+  if (!entry && rb != SKBD_ALLUP)
+    COUNT(counters.unknownKeys);
+
+  // keys of a leader sequence don't go to the host, and aren't
+  // held as themselves either
+  if (leaderActive)
+    {
+      held = leaderKey(rb, entry, now);
+      if (held != entry)
+        return keyDispatch(held, 0);
+    }
+
+  if (entry)
+    {
+      keyDown[rb >> 3] |= 1 << (rb & 7);
+      turboPress(rb, entry);
+    }
+
+  return keyDispatch(entry, 0);
+}
+
+// a byte from the keyboard, returns 1 if it is a key
+uint8_t translateByte(uint8_t rb, uint16_t now)
+{
+  // set by the special state characters for the byte following them
+  static uint8_t expect = 0;
+
+  if (expect)
+    {
+      // layout reply, the byte after reset is the keyboard type
+      if (expect == SKBD_LYOUT)
+        {
+          rekeyed |= heldKeys(1);
+          keymapLayout(rb);
+          heldKeys(0);
+          traceAdd(TRACE_LAYOUT, rb, 0);
+        }
+      expect = 0;
+      return 0;
+    }
+
+  if (rb == SKBD_LYOUT || rb == SKBD_RESET)
+    {
+      expect = rb;
+      return 0;
+    }
+
+  tapholdFeed(rb, now);
+  return 1;
+}
+
+#ifdef WITH_REMAP
+// runtime overrides, see remap.c. keys held are released with the
+// usage they were pressed with.
+uint8_t translateRemap(uint8_t sc, uint8_t usage)
+{
+  uint8_t ok;
+
+  rekeyed |= heldKeys(1);
+  ok = remapSet(sc, usage);
+  heldKeys(0);
+
+  return ok;
+}
+
+void translateRemapClear()
+{
+  rekeyed |= heldKeys(1);
+  remapClear();
+  heldKeys(0);
+}
+#endif
+
+// timeouts of the event stages
+void translatePoll(uint16_t now)
+{
+  tapholdPoll(now);
+  comboPoll(now);
+  leaderPoll(now);
+}
+
+// the next report, once the host took the last one.
+// returns 1 if the keyboard report changed.
+uint8_t translateStep(uint16_t now)
+{
+  uint16_t ev;
+  uint8_t changed;
+
+  // macro playback advances one step per report:
+  changed = macroStep();
+  if (!changed && !macroPlaying())
+    ledStop(LED_MACRO);
+
+  changed |= rekeyed;
+  rekeyed = 0;
+
+  // one key event per report, so the host sees every edge in
+  // order. events that don't change the report go on the way.
+  // turbo edges aren't keystrokes, latency.c must not time them.
+  while (eventGet(&ev))
+    {
+      if (buildUsbReport(ev, now))
+        return (ev & EVENT_TURBO) ? TRANSLATE_CHANGED : TRANSLATE_CHANGED | TRANSLATE_KEY;
+    }
+
+  return changed ? TRANSLATE_CHANGED : 0;
+}
+
+// the report for the host: live state + macro overlay
+void translateReport(uint8_t *out)
+{
+  uint8_t i;
+
+  for (i = 0; i < sizeof report; i++)
+    out[i] = report[i];
+
+  macroOverlay(out, sizeof report);
+}
@@ -0,0 +1,26 @@
+#ifndef TRANSLATE_HEADER_H
+# define TRANSLATE_HEADER_H
+
+#include <stdint.h>
+
+// [id][modifiers][6 keys]
+#define KEYBOARD_REPORT_SIZE  8
+
+uint8_t translateByte(uint8_t rb, uint16_t now);
+void translatePoll(uint16_t now);
+// translateStep() flags, 0 if the report didn't change
+#define TRANSLATE_CHANGED  0x01
+#define TRANSLATE_KEY      0x02   // the change came from a key edge
+
+uint8_t translateStep(uint16_t now);
+void translateReport(uint8_t *out);
+#ifdef WITH_REMAP
+uint8_t translateRemap(uint8_t sc, uint8_t usage);
+void translateRemapClear(void);
+#endif
+
+// provided by the glue: a command for the keyboard,
+// dropped if the transmitter is busy
+void keyboardSend(uint8_t cmd);
+
+#endif
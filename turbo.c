@@ -0,0 +1,123 @@
+/*
+ * Turbo keys: while held, the key is released and pressed again at a
+ * fixed rate.
+ *
+ * The rate is kept on the millisecond tick with an accumulator, so it
+ * is exact on average and doesn't drift with the main loop. Only one
+ * edge is in the event queue at a time: an edge that falls due before
+ * the last one went out is counted as missed, the achieved rate shows
+ * how much of the configured one USB polling let through.
+ * One turbo key is active at a time, the last one pressed.
+ */
+#include "keymap.h"
+#include "events.h"
+#include "turbo.h"
+
+TurboStats turboStats = {TURBO_RATE_DEFAULT, 0, 0};
+
+// scancodes with turbo on
+static uint8_t turboKeys[128 / 8];
+
+// held turbo key, 0 if none
+static uint8_t key = 0;
+static uint16_t entry;
+static uint8_t down;
+static uint8_t queued;
+static uint8_t sentDown;     // the last edge the host got
+
+// edges: 2 * rate per 1000 ms
+static uint16_t phase;
+static uint16_t last;
+
+// pairs sent in the current second
+static uint16_t sent;
+static uint16_t second;
+
+void turboSet(uint8_t sc, uint8_t on)
+{
+  sc &= 0x7f;
+  if (on)
+    turboKeys[sc >> 3] |= 1 << (sc & 7);
+  else
+    turboKeys[sc >> 3] &= ~(1 << (sc & 7));
+}
+
+void turboRate(uint16_t hz)
+{
+  if (hz == 0 || hz > TURBO_RATE_MAX)
+    return;
+
+  turboStats.rate = hz;
+  turboStats.missed = 0;
+}
+
+// a key went down, its press went to the host already
+void turboPress(uint8_t sc, uint16_t e)
+{
+  if (!(turboKeys[sc >> 3] & (1 << (sc & 7))))
+    return;
+
+  key = sc;
+  entry = e;
+  down = 1;
+  sentDown = 1;
+  phase = 0;
+}
+
+// the key went up. returns 1 if the last turbo edge sent was a
+// release already, the key's own release must not go out again.
+uint8_t turboRelease(uint8_t sc)
+{
+  if (sc != key)
+    return 0;
+
+  key = 0;
+  return !sentDown;
+}
+
+// a turbo edge is taken out of the queue. returns 0 if the key
+// was released meanwhile and the edge has to be dropped.
+uint8_t turboSent()
+{
+  queued = 0;
+
+  if (key == 0)
+    return 0;
+
+  if (!down)
+    sent++;
+  sentDown = down;
+  return 1;
+}
+
+void turboPoll(uint16_t now)
+{
+  uint16_t ms = now - last;
+  uint32_t acc;
+
+  last = now;
+
+  if ((uint16_t)(now - second) >= 1000)
+    {
+      second = now;
+      turboStats.achieved = sent;
+      sent = 0;
+    }
+
+  if (key == 0)
+    return;
+
+  for (acc = phase + (uint32_t)ms * 2 * turboStats.rate; acc >= 1000; acc -= 1000)
+    {
+      if (queued)
+        {
+          turboStats.missed++;
+          continue;
+        }
+
+      down = !down;
+      queued = eventPut(EVENT_KEY(entry, !down) | EVENT_TURBO);
+    }
+
+  phase = acc;
+}
@@ -0,0 +1,36 @@
+#ifndef TURBO_HEADER_H
+# define TURBO_HEADER_H
+
+#include <stdint.h>
+
+// press/release pairs per second. the host polls every 10 ms, 100
+// reports per second, and a pair takes two: 50 Hz is as fast as it
+// gets.
+#define TURBO_RATE_DEFAULT  30
+#define TURBO_RATE_MAX      500
+
+// rates reported by VREQ_TURBO_GET
+typedef struct
+{
+  uint16_t rate;       // configured, Hz
+  uint16_t achieved;   // pairs sent in the last second
+  uint16_t missed;     // edges due while the last one wasn't sent yet
+} TurboStats;
+
+#ifdef WITH_TURBO
+extern TurboStats turboStats;
+
+void turboSet(uint8_t sc, uint8_t on);
+void turboRate(uint16_t hz);
+void turboPress(uint8_t sc, uint16_t entry);
+uint8_t turboRelease(uint8_t sc);
+uint8_t turboSent(void);
+void turboPoll(uint16_t now);
+#else
+// no key repeats, the vendor requests are left out
+# define turboPress(sc, entry)
+# define turboRelease(sc)       0
+# define turboSent()            1
+#endif
+
+#endif
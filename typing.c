@@ -0,0 +1,111 @@
+/*
+ * ASCII -> HID usage tables used by the string macros.
+ *
+ * One byte per printable character (0x20 - 0x7e):
+ * bit 7 - shift, bit 6 - AltGr, bits 0-5 - usage.
+ * Usages that don't fit in 6 bits go through typingEscapes.
+ */
+#include <avr/pgmspace.h>
+
+#include "sun_defs.h"
+#include "typing.h"
+
+#define SH  0x80
+#define AG  0x40
+#define USAGE_MASK  0x3f
+
+// escape codes, index into typingEscapes:
+#define ESC_FIRST   0x3d
+#define DEAD_ACUTE  0x3d
+#define DEAD_CIRC   0x3e
+#define NUBS        0x3f
+
+static const uint8_t typingEscapes[] PROGMEM = {
+  0x2e | TYPING_DEAD,     // ´ and ` on the german layout
+  0x35 | TYPING_DEAD,     // ^ on the german layout
+  0x64                    // non-US \ and |, < and > on the german layout
+};
+
+static const uint8_t typingTables[TYPING_LAYOUTS][0x7f - 0x20] PROGMEM = {
+  {
+/*  ' '     !       "       #       $       %       &       '      */
+    0x2c,   SH|0x1e,SH|0x34,SH|0x20,SH|0x21,SH|0x22,SH|0x24,0x34,    /* 0x20-0x27 */
+/*  (       )       *       +       ,       -       .       /      */
+    SH|0x26,SH|0x27,SH|0x25,SH|0x2e,0x36,   0x2d,   0x37,   0x38,    /* 0x28-0x2f */
+/*  0       1       2       3       4       5       6       7      */
+    0x27,   0x1e,   0x1f,   0x20,   0x21,   0x22,   0x23,   0x24,    /* 0x30-0x37 */
+/*  8       9       :       ;       <       =       >       ?      */
+    0x25,   0x26,   SH|0x33,0x33,   SH|0x36,0x2e,   SH|0x37,SH|0x38, /* 0x38-0x3f */
+/*  @       A       B       C       D       E       F       G      */
+    SH|0x1f,SH|0x04,SH|0x05,SH|0x06,SH|0x07,SH|0x08,SH|0x09,SH|0x0a, /* 0x40-0x47 */
+/*  H       I       J       K       L       M       N       O      */
+    SH|0x0b,SH|0x0c,SH|0x0d,SH|0x0e,SH|0x0f,SH|0x10,SH|0x11,SH|0x12, /* 0x48-0x4f */
+/*  P       Q       R       S       T       U       V       W      */
+    SH|0x13,SH|0x14,SH|0x15,SH|0x16,SH|0x17,SH|0x18,SH|0x19,SH|0x1a, /* 0x50-0x57 */
+/*  X       Y       Z       [       \       ]       ^       _      */
+    SH|0x1b,SH|0x1c,SH|0x1d,0x2f,   0x31,   0x30,   SH|0x23,SH|0x2d, /* 0x58-0x5f */
+/*  `       a       b       c       d       e       f       g      */
+    0x35,   0x04,   0x05,   0x06,   0x07,   0x08,   0x09,   0x0a,    /* 0x60-0x67 */
+/*  h       i       j       k       l       m       n       o      */
+    0x0b,   0x0c,   0x0d,   0x0e,   0x0f,   0x10,   0x11,   0x12,    /* 0x68-0x6f */
+/*  p       q       r       s       t       u       v       w      */
+    0x13,   0x14,   0x15,   0x16,   0x17,   0x18,   0x19,   0x1a,    /* 0x70-0x77 */
+/*  x       y       z       {       |       }       ~              */
+    0x1b,   0x1c,   0x1d,   SH|0x2f,SH|0x31,SH|0x30,SH|0x35          /* 0x78-0x7e */
+  },
+  {
+/*  ' '     !       "       #       $       %       &       '      */
+    0x2c,   SH|0x1e,SH|0x1f,0x32,   SH|0x21,SH|0x22,SH|0x23,SH|0x32, /* 0x20-0x27 */
+/*  (       )       *       +       ,       -       .       /      */
+    SH|0x25,SH|0x26,SH|0x30,0x30,   0x36,   0x38,   0x37,   SH|0x24, /* 0x28-0x2f */
+/*  0       1       2       3       4       5       6       7      */
+    0x27,   0x1e,   0x1f,   0x20,   0x21,   0x22,   0x23,   0x24,    /* 0x30-0x37 */
+/*  8       9       :       ;       <       =       >       ?      */
+    0x25,   0x26,   SH|0x37,SH|0x36,NUBS,   SH|0x27,SH|NUBS,SH|0x2d, /* 0x38-0x3f */
+/*  @       A       B       C       D       E       F       G      */
+    AG|0x14,SH|0x04,SH|0x05,SH|0x06,SH|0x07,SH|0x08,SH|0x09,SH|0x0a, /* 0x40-0x47 */
+/*  H       I       J       K       L       M       N       O      */
+    SH|0x0b,SH|0x0c,SH|0x0d,SH|0x0e,SH|0x0f,SH|0x10,SH|0x11,SH|0x12, /* 0x48-0x4f */
+/*  P       Q       R       S       T       U       V       W      */
+    SH|0x13,SH|0x14,SH|0x15,SH|0x16,SH|0x17,SH|0x18,SH|0x19,SH|0x1a, /* 0x50-0x57 */
+/*  X       Y       Z       [       \       ]       ^       _      */
+    SH|0x1b,SH|0x1d,SH|0x1c,AG|0x25,AG|0x2d,AG|0x26,DEAD_CIRC,SH|0x38, /* 0x58-0x5f */
+/*  `       a       b       c       d       e       f       g      */
+    SH|DEAD_ACUTE,0x04,0x05,0x06,   0x07,   0x08,   0x09,   0x0a,    /* 0x60-0x67 */
+/*  h       i       j       k       l       m       n       o      */
+    0x0b,   0x0c,   0x0d,   0x0e,   0x0f,   0x10,   0x11,   0x12,    /* 0x68-0x6f */
+/*  p       q       r       s       t       u       v       w      */
+    0x13,   0x14,   0x15,   0x16,   0x17,   0x18,   0x19,   0x1a,    /* 0x70-0x77 */
+/*  x       y       z       {       |       }       ~              */
+    0x1b,   0x1d,   0x1c,   AG|0x24,AG|NUBS,AG|0x27,AG|0x30          /* 0x78-0x7e */
+  }
+};
+
+// translate ASCII character to usage and modifier byte.
+// returns 0 if the character can't be typed on the layout.
+uint8_t typingLookup(uint8_t layout, uint8_t c, uint8_t *modifier)
+{
+  uint8_t entry, usage;
+
+  *modifier = 0;
+
+  if (c == '\n')
+    return USB_KEY_ENTER;
+  if (c == '\t')
+    return USB_KEY_TAB;
+  if (c < 0x20 || c > 0x7e || layout >= TYPING_LAYOUTS)
+    return 0;
+
+  entry = pgm_read_byte(&(typingTables[layout][c - 0x20]));
+
+  if (entry & SH)
+    *modifier |= USB_MOD_LSHIFT;
+  if (entry & AG)
+    *modifier |= USB_MOD_RALT;
+
+  usage = entry & USAGE_MASK;
+  if (usage >= ESC_FIRST)
+    usage = pgm_read_byte(&(typingEscapes[usage - ESC_FIRST]));
+
+  return usage;
+}
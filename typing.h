@@ -0,0 +1,17 @@
+#ifndef TYPING_HEADER_H
+# define TYPING_HEADER_H
+
+#include <stdint.h>
+
+// host layouts the typing tables are written for:
+#define TYPING_US        0
+#define TYPING_DE        1
+#define TYPING_LAYOUTS   2
+
+// set in the returned usage if the key is a dead key and
+// has to be followed by a space to produce the character:
+#define TYPING_DEAD      0x80
+
+uint8_t typingLookup(uint8_t layout, uint8_t c, uint8_t *modifier);
+
+#endif
@@ -1,8 +0,0 @@
-#ifndef UTILS_HEADER_H
-# define UTILS_HEADER_H
-
-void blinkB1();
-void blinkB2();
-void blinkB3();
-
-#endif